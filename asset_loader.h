@@ -0,0 +1,432 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+/*
+* Asset loader
+- Reading files and decoding images off the GL thread, it never waits on disk or stb_image
+- loadHeightMap / loadTexture: queued for the loader thread, return an id at once
+- Loader thread: every queued asset is decoded as a job of the job system (see job_system.h)
+  as soon as it is requested -> several images decode in parallel, the loader thread helps
+  while it waits
+- Every job signals the loader thread when it is done -> assets are handed over in the order
+  they finish, a small texture never waits behind a big height map
+- Decoding: HeightMap::load (decode or .hmap cache, see terrain_heightmap.h) / stbi_load,
+  every finished asset is handed to the GL thread through a lock-free ring
+  (one producer: the loader thread, one consumer: the GL thread)
+- update(): once per frame on the GL thread, takes the finished assets and uploads them
+
+* Placeholders
+- A texture exists from loadTexture on: one texel of the placeholder color
+  -> it can be bound and drawn with before the file is even read
+- The image is uploaded in bands of rows, at most UploadBudget bytes per update()
+  -> a big image fills in over several frames instead of one long frame
+- Mipmaps (optional) are generated after the last band, the texture is limited to
+  level 0 until then
+
+* Pixel buffer objects
+- Every band is copied into a pixel buffer object, glTexSubImage2D reads from it
+  -> the driver copies to the texture asynchronously, the call returns right away
+- Two buffers used in turn, orphaned before each band (glBufferData NULL)
+  -> a band never waits for the GPU to finish reading the previous one
+
+* Report
+- assets, time spent decoding (all jobs), bytes uploaded, frames the uploads were spread over
+*/
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <iostream>
+#include "terrain_heightmap.h"
+#include "job_system.h"
+// stbi_load: include stb_image.h before this header, once with STB_IMAGE_IMPLEMENTATION
+
+// Defines the kinds of assets the loader reads
+enum Asset_Type {
+    ASSET_HEIGHT_MAP,
+    ASSET_TEXTURE,
+    NUM_ASSET_TYPES
+};
+const char *const ASSET_TYPE_NAMES[NUM_ASSET_TYPES] = {
+    "height map",
+    "texture"
+};
+
+// fixed size ring, lock-free for exactly one pushing and one popping thread
+template <typename T, size_t Capacity>
+class AssetQueue
+{
+public:
+    // producer, false if full
+    bool push(const T &item)
+    {
+        const size_t tail = Tail.load(std::memory_order_relaxed);
+        const size_t next = (tail + 1) % Capacity;
+        if (next == Head.load(std::memory_order_acquire))
+            return false;
+        items[tail] = item;
+        // release: the item (and everything written before the push) is visible to pop()
+        Tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // consumer, false if empty
+    bool pop(T &item)
+    {
+        const size_t head = Head.load(std::memory_order_relaxed);
+        if (head == Tail.load(std::memory_order_acquire))
+            return false;
+        item = items[head];
+        Head.store((head + 1) % Capacity, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T items[Capacity];
+    // head and tail on their own cache lines, written by different threads
+    alignas(64) std::atomic<size_t> Head{0};
+    alignas(64) std::atomic<size_t> Tail{0};
+};
+
+class AssetLoader
+{
+public:
+    // bytes uploaded per update() at most (a single row may exceed it)
+    size_t UploadBudget = 4 * 1024 * 1024;
+    // stats
+    unsigned int Loaded = 0;
+    unsigned int Failed = 0;
+    double DecodeMs = 0.0;
+    unsigned long long UploadedBytes = 0;
+    unsigned long long UploadFrames = 0;
+
+    // assets decoded as jobs of jobs, NULL -> the shared job system
+    explicit AssetLoader(JobSystem *jobs = NULL)
+        : jobs(jobs ? jobs : &JobSystem::shared()), loaderThread(&AssetLoader::run, this) {}
+    ~AssetLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        loaderThread.join();
+        for (std::unique_ptr<Asset> &asset : assets)
+        {
+            if (asset->pixels)
+                stbi_image_free(asset->pixels);
+        }
+    }
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    // height map read on the loader thread, heightMap(id) once ready
+    unsigned int loadHeightMap(const std::string &path)
+    {
+        return request(ASSET_HEIGHT_MAP, path);
+    }
+
+    // GL thread: texture of a placeholder texel now, the image once uploaded
+    // channels: 1-4, 0 -> as many as the file has
+    unsigned int loadTexture(const std::string &path, int channels = 0, bool mipmaps = true,
+                             const unsigned char placeholder[4] = NULL)
+    {
+        static const unsigned char gray[4] = {128, 128, 128, 255};
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder ? placeholder : gray);
+        return request(ASSET_TEXTURE, path, channels, mipmaps, texture);
+    }
+
+    // loaded and (textures) completely uploaded
+    bool ready(unsigned int id) const { return assets[id]->ready; }
+    // the file could not be read / decoded
+    bool failed(unsigned int id) const { return assets[id]->failed; }
+
+    // NULL until ready, samples stay valid while the loader lives (or until close())
+    HeightMap *heightMap(unsigned int id) { return ready(id) ? &assets[id]->heightMap : NULL; }
+    // usable at once, placeholder until ready
+    GLuint texture(unsigned int id) const { return assets[id]->texture; }
+
+    // GL thread: take the finished assets, upload up to budget bytes, number of assets not ready yet
+    unsigned int update(size_t budget)
+    {
+        Asset *asset;
+        while (finished.pop(asset))
+        {
+            DecodeMs += asset->decodeMs;
+            if (asset->decodeFailed)
+            {
+                std::cout << "ERROR::ASSET_LOADER::NOT_LOADED " << ASSET_TYPE_NAMES[asset->type] << " " << asset->path << std::endl;
+                asset->failed = true;
+                Failed++;
+            }
+            else if (asset->type == ASSET_TEXTURE)
+                uploading.push_back(asset);
+            else
+            {
+                asset->ready = true;
+                Loaded++;
+            }
+        }
+
+        size_t uploaded = 0;
+        while (!uploading.empty() && uploaded < budget)
+        {
+            Asset &texture = *uploading.front();
+            uploaded += uploadRows(texture, budget - uploaded);
+            if (texture.uploadedRows == texture.height)
+            {
+                finishTexture(texture);
+                uploading.pop_front();
+            }
+        }
+        if (uploaded)
+        {
+            UploadedBytes += uploaded;
+            UploadFrames++;
+        }
+
+        unsigned int pending = 0;
+        for (const std::unique_ptr<Asset> &a : assets)
+            pending += !a->ready && !a->failed;
+        return pending;
+    }
+    unsigned int update() { return update(UploadBudget); }
+
+    // GL thread: block until the asset is ready (or failed), everything finished meanwhile is uploaded
+    bool wait(unsigned int id)
+    {
+        while (!ready(id) && !failed(id))
+        {
+            if (update(SIZE_MAX))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return ready(id);
+    }
+
+    void printReport() const
+    {
+        std::cout << "Assets: " << Loaded << " loaded";
+        if (Failed)
+            std::cout << ", " << Failed << " failed";
+        std::cout << ", " << DecodeMs << " ms decoding, "
+                  << UploadedBytes / 1024 << " KB uploaded through PBOs over " << UploadFrames << " frames" << std::endl;
+    }
+
+private:
+    struct Asset
+    {
+        Asset_Type type;
+        std::string path;
+        int channels = 0;
+        bool mipmaps = false;
+        // decode output
+        HeightMap heightMap;
+        unsigned char *pixels = NULL;
+        int width = 0;
+        int height = 0;
+        double decodeMs = 0.0;
+        bool decodeFailed = false;
+        // GL thread
+        GLuint texture = 0;
+        int uploadedRows = 0;
+        bool ready = false;
+        bool failed = false;
+    };
+
+    // owned here, only the GL thread adds to it, the loader thread gets pointers
+    std::vector<std::unique_ptr<Asset>> assets;
+    // GL thread -> loader thread, guarded by mutex (the loader thread sleeps on it)
+    std::deque<Asset *> requests;
+    // decode jobs -> loader thread, guarded by mutex, in the order they finished
+    std::deque<Asset *> decoded;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    // loader thread -> GL thread
+    AssetQueue<Asset *, 64> finished;
+    // GL thread: textures with rows left to upload, in order
+    std::deque<Asset *> uploading;
+    GLuint pbos[2] = {0, 0};
+    unsigned int nextPBO = 0;
+    JobSystem *jobs;
+    // last member: started once everything above exists
+    std::thread loaderThread;
+
+    unsigned int request(Asset_Type type, const std::string &path, int channels = 0, bool mipmaps = false, GLuint texture = 0)
+    {
+        assets.push_back(std::unique_ptr<Asset>(new Asset()));
+        Asset *asset = assets.back().get();
+        asset->type = type;
+        asset->path = path;
+        asset->channels = channels;
+        asset->mipmaps = mipmaps;
+        asset->texture = texture;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push_back(asset);
+        }
+        wake.notify_one();
+        return (unsigned int)assets.size() - 1;
+    }
+
+    // loader thread: every request decoded as a job as soon as it arrives, every asset handed
+    // over as soon as its job is done, it helps with the jobs meanwhile
+    void run()
+    {
+        // jobs not done yet, waited for before the loader stops
+        std::vector<JobSystem::JobHandle> decoding;
+        bool stop = false;
+        while (!stop)
+        {
+            std::deque<Asset *> started, done;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // idle: nothing requested, nothing decoding
+                wake.wait(lock, [&] { return stopping || !requests.empty() || !decoded.empty() || !decoding.empty(); });
+                stop = stopping;
+                if (!stop)
+                    started.swap(requests);
+                done.swap(decoded);
+            }
+            for (Asset *asset : started)
+            {
+                decoding.push_back(jobs->run([this, asset] {
+                    decode(*asset);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        decoded.push_back(asset);
+                    }
+                    wake.notify_one();
+                }));
+            }
+            for (Asset *asset : done)
+            {
+                // full ring: the GL thread has not called update() for a while
+                while (!stop && !finished.push(asset))
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = stopping;
+                }
+            }
+            // a done job has already queued its asset
+            decoding.erase(std::remove_if(decoding.begin(), decoding.end(),
+                                          [this](const JobSystem::JobHandle &job) { return jobs->done(job); }),
+                           decoding.end());
+            if (!stop && started.empty() && done.empty() && !decoding.empty() && !jobs->help())
+            {
+                // every job runs on another thread: sleep until one is done (or a request comes in)
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !requests.empty() || !decoded.empty(); });
+            }
+        }
+        for (const JobSystem::JobHandle &job : decoding)
+            jobs->wait(job);
+    }
+
+    // any thread of the job system
+    static void decode(Asset &asset)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (asset.type == ASSET_HEIGHT_MAP)
+            asset.decodeFailed = !asset.heightMap.load(asset.path);
+        else
+        {
+            int fileChannels;
+            asset.pixels = stbi_load(asset.path.c_str(), &asset.width, &asset.height, &fileChannels, asset.channels);
+            if (asset.pixels && !asset.channels)
+                asset.channels = fileChannels;
+            asset.decodeFailed = !asset.pixels;
+        }
+        asset.decodeMs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+    }
+
+    static GLenum pixelFormat(int channels)
+    {
+        static const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+        return formats[channels - 1];
+    }
+    static GLenum internalFormat(int channels)
+    {
+        static const GLenum formats[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+        return formats[channels - 1];
+    }
+
+    // next band of rows through a pixel buffer object, bytes uploaded
+    size_t uploadRows(Asset &texture, size_t budget)
+    {
+        const size_t rowBytes = (size_t)texture.width * texture.channels;
+        const int rows = (int)std::min<size_t>(std::max<size_t>(budget / rowBytes, 1), texture.height - texture.uploadedRows);
+        const size_t bytes = rowBytes * rows;
+
+        glBindTexture(GL_TEXTURE_2D, texture.texture);
+        // rows are tightly packed (3 channel rows are not a multiple of 4 bytes)
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (texture.uploadedRows == 0)
+        {
+            // real size replaces the placeholder, contents follow band by band
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(texture.channels), texture.width, texture.height, 0,
+                         pixelFormat(texture.channels), GL_UNSIGNED_BYTE, NULL);
+        }
+        if (!pbos[0])
+            glGenBuffers(2, pbos);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPBO]);
+        nextPBO = (nextPBO + 1) % 2;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        const unsigned char *band = texture.pixels + rowBytes * texture.uploadedRows;
+        if (mapped)
+        {
+            std::memcpy(mapped, band, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            // offset 0 into the bound pixel buffer object, not a pointer
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, texture.uploadedRows, texture.width, rows,
+                            pixelFormat(texture.channels), GL_UNSIGNED_BYTE, (void *)0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        else
+        {
+            // mapping failed: plain upload from client memory
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, texture.uploadedRows, texture.width, rows,
+                            pixelFormat(texture.channels), GL_UNSIGNED_BYTE, band);
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        texture.uploadedRows += rows;
+        return bytes;
+    }
+
+    void finishTexture(Asset &texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture.texture);
+        if (texture.mipmaps)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        stbi_image_free(texture.pixels);
+        texture.pixels = NULL;
+        texture.ready = true;
+        Loaded++;
+    }
+};
+
+#endif
@@ -66,6 +66,15 @@ public:
         return glm::lookAt(Position, Position + Front, Up);
     }
 
+    // places the camera at a position looking along the given Euler angles (e.g. from a scripted camera path)
+    void SetPose(glm::vec3 position, float yaw, float pitch)
+    {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
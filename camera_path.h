@@ -0,0 +1,242 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+/*
+* Camera path
+- Keyframes of (time, position, yaw, pitch), loaded from a text file:
+    # comment
+    time x y z yaw pitch
+  one keyframe per line, times in seconds, strictly increasing
+- sample(t): Catmull-Rom spline through the keyframes
+    - segment i runs from keyframe i to i + 1, its tangents come from
+      keyframes i - 1 and i + 2 (first / last keyframe repeated at the ends)
+    - tangents scaled by the segment duration -> keyframes do not need
+      to be evenly spaced in time
+    - yaw unwrapped while loading -> turning through 180 / -180 takes the short way
+- The benchmark steps t by a fixed simulated timestep, not the wall clock
+  -> every run renders exactly the same camera poses
+
+* Path benchmark
+- Frame times (and draw calls / triangles) collected per path segment
+- printReport(): frames, mean, p50 / p95 / p99 / max per segment and over all
+- writeResults(path): same table as CSV, one row per segment, last row "all"
+  -> runs of different builds can be diffed
+*/
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+struct CameraKeyframe
+{
+    float time;
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+class CameraPath
+{
+public:
+    std::vector<CameraKeyframe> Keyframes;
+
+    bool load(const std::string &path)
+    {
+        Keyframes.clear();
+        std::ifstream stream(path);
+        if (!stream)
+        {
+            std::cout << "ERROR::CAMERA_PATH::FILE_NOT_READ " << path << std::endl;
+            return false;
+        }
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(stream, line))
+        {
+            lineNumber++;
+            const size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.erase(comment);
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            std::istringstream fields(line);
+            CameraKeyframe key;
+            if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+                || (!Keyframes.empty() && key.time <= Keyframes.back().time))
+            {
+                std::cout << "ERROR::CAMERA_PATH::INVALID_KEYFRAME " << path << ":" << lineNumber << std::endl;
+                return false;
+            }
+            // shortest turn from the previous keyframe
+            if (!Keyframes.empty())
+            {
+                const float previous = Keyframes.back().yaw;
+                key.yaw = previous + std::remainder(key.yaw - previous, 360.0f);
+            }
+            Keyframes.push_back(key);
+        }
+        if (Keyframes.size() < 2)
+        {
+            std::cout << "ERROR::CAMERA_PATH::NOT_ENOUGH_KEYFRAMES " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    float duration() const { return Keyframes.empty() ? 0.0f : Keyframes.back().time - Keyframes.front().time; }
+    unsigned int numSegments() const { return Keyframes.size() > 1 ? (unsigned int)Keyframes.size() - 1 : 0; }
+
+    // segment containing time t (clamped to the path)
+    unsigned int segment(float t) const
+    {
+        unsigned int i = 0;
+        while (i + 1 < numSegments() && t >= Keyframes[i + 1].time)
+            i++;
+        return i;
+    }
+
+    // pose at time t (clamped to the path)
+    CameraKeyframe sample(float t) const
+    {
+        const unsigned int i = segment(t);
+        const CameraKeyframe &k1 = Keyframes[i];
+        const CameraKeyframe &k2 = Keyframes[i + 1];
+        const CameraKeyframe &k0 = Keyframes[i > 0 ? i - 1 : i];
+        const CameraKeyframe &k3 = Keyframes[std::min<size_t>(i + 2, Keyframes.size() - 1)];
+        const float dt = k2.time - k1.time;
+        const float u = std::min(std::max((t - k1.time) / dt, 0.0f), 1.0f);
+        // tangents per second (finite differences over the neighbours), times the segment duration
+        const float s0 = dt / (k2.time - k0.time);
+        const float s1 = dt / (k3.time - k1.time);
+
+        CameraKeyframe pose;
+        pose.time = t;
+        pose.position = hermite(k1.position, k2.position, (k2.position - k0.position) * s0, (k3.position - k1.position) * s1, u);
+        pose.yaw = hermite(k1.yaw, k2.yaw, (k2.yaw - k0.yaw) * s0, (k3.yaw - k1.yaw) * s1, u);
+        pose.pitch = hermite(k1.pitch, k2.pitch, (k2.pitch - k0.pitch) * s0, (k3.pitch - k1.pitch) * s1, u);
+        pose.pitch = std::min(std::max(pose.pitch, -89.0f), 89.0f);
+        return pose;
+    }
+
+private:
+    // cubic Hermite between p1 and p2 with tangents m1, m2
+    template <typename Value>
+    static Value hermite(const Value &p1, const Value &p2, const Value &m1, const Value &m2, float u)
+    {
+        const float u2 = u * u, u3 = u2 * u;
+        return p1 * (2.0f * u3 - 3.0f * u2 + 1.0f) + m1 * (u3 - 2.0f * u2 + u)
+             + p2 * (-2.0f * u3 + 3.0f * u2) + m2 * (u3 - u2);
+    }
+};
+
+class CameraPathBenchmark
+{
+public:
+    CameraPathBenchmark(const CameraPath &path) : path(path), segments(path.numSegments() + 1) {}
+
+    // one rendered frame at path time t
+    void record(float t, double frameMs, unsigned int drawCalls, unsigned long long triangles)
+    {
+        Frame frame = {frameMs, drawCalls, triangles};
+        segments[path.segment(t)].push_back(frame);
+        segments.back().push_back(frame);
+    }
+
+    void printReport() const
+    {
+        const std::ios::fmtflags flags = std::cout.flags();
+        const std::streamsize precision = std::cout.precision();
+        std::cout << "Camera path: " << path.numSegments() << " segments, " << path.duration() << " s" << std::endl;
+        std::cout << std::setw(8) << "segment" << std::setw(8) << "frames" << std::setw(10) << "mean ms"
+                  << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max"
+                  << std::setw(12) << "triangles" << std::endl;
+        for (unsigned int s = 0; s < segments.size(); s++)
+        {
+            const Summary summary = summarize(segments[s]);
+            std::cout << std::setw(8) << segmentName(s) << std::setw(8) << segments[s].size()
+                      << std::fixed << std::setprecision(2) << std::setw(10) << summary.mean
+                      << std::setw(10) << summary.p50 << std::setw(10) << summary.p95
+                      << std::setw(10) << summary.p99 << std::setw(10) << summary.max
+                      << std::setprecision(0) << std::setw(12) << summary.triangles << std::endl;
+        }
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+
+    bool writeResults(const std::string &resultsPath) const
+    {
+        std::ofstream stream(resultsPath, std::ios::trunc);
+        if (!stream)
+        {
+            std::cout << "ERROR::CAMERA_PATH::RESULTS_NOT_WRITTEN " << resultsPath << std::endl;
+            return false;
+        }
+        stream << "segment,start_s,end_s,frames,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,mean_draw_calls,mean_triangles\n";
+        for (unsigned int s = 0; s < segments.size(); s++)
+        {
+            const Summary summary = summarize(segments[s]);
+            const bool all = s == segments.size() - 1;
+            stream << segmentName(s) << ","
+                   << path.Keyframes[all ? 0 : s].time << "," << path.Keyframes[all ? path.numSegments() : s + 1].time << ","
+                   << segments[s].size() << "," << summary.mean << "," << summary.p50 << "," << summary.p95 << ","
+                   << summary.p99 << "," << summary.max << "," << summary.drawCalls << "," << summary.triangles << "\n";
+        }
+        return true;
+    }
+
+private:
+    struct Frame
+    {
+        double ms;
+        unsigned int drawCalls;
+        unsigned long long triangles;
+    };
+    struct Summary
+    {
+        double mean = 0.0, p50 = 0.0, p95 = 0.0, p99 = 0.0, max = 0.0;
+        double drawCalls = 0.0, triangles = 0.0;
+    };
+
+    const CameraPath &path;
+    // frames of every segment, last entry: all frames
+    std::vector<std::vector<Frame>> segments;
+
+    std::string segmentName(unsigned int s) const
+    {
+        return s == segments.size() - 1 ? "all" : std::to_string(s);
+    }
+
+    static Summary summarize(const std::vector<Frame> &frames)
+    {
+        Summary summary;
+        if (frames.empty())
+            return summary;
+        std::vector<double> ms;
+        ms.reserve(frames.size());
+        for (const Frame &frame : frames)
+        {
+            ms.push_back(frame.ms);
+            summary.mean += frame.ms;
+            summary.drawCalls += frame.drawCalls;
+            summary.triangles += (double)frame.triangles;
+        }
+        summary.mean /= frames.size();
+        summary.drawCalls /= frames.size();
+        summary.triangles /= frames.size();
+        std::sort(ms.begin(), ms.end());
+        const auto percentile = [&ms](double p) { return ms[(size_t)(p * (ms.size() - 1) + 0.5)]; };
+        summary.p50 = percentile(0.50);
+        summary.p95 = percentile(0.95);
+        summary.p99 = percentile(0.99);
+        summary.max = ms.back();
+        return summary;
+    }
+};
+
+#endif
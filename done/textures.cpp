@@ -42,6 +42,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "shaders.h"
+#include "asset_loader.h"
 
 // when user resizes the window -> viewport adjusted
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
@@ -104,31 +105,12 @@ int main()
     };
 
     // * Texture
-    unsigned int texture;
-    glGenTextures(1, &texture);
-        // - how many textures we want to generate
-        // - store in unsigned int array (in this case, single int)
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("container.jpeg", &width, &height, &nrChannels, 0);
-    if(data)
-    {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        // Now currently bound texture object new has the texture image attached to it.
-        // only base-level of the texture image
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data); // good practice to free memory after generating texture
+    // - glGenTextures + wrap (GL_REPEAT) / filter (GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR) options
+    //   right away, the texture holds a placeholder texel until the image is there
+    // - stbi_load on the loader thread, glTexImage2D from a pixel buffer object on this one,
+    //   glGenerateMipmap after the upload, image memory freed afterwards (see asset_loader.h)
+    AssetLoader assets;
+    unsigned int container = assets.loadTexture("container.jpeg", 3);
 
     unsigned int VBO, VAO, EBO;
     glGenVertexArrays(1, &VAO);
@@ -163,8 +145,11 @@ int main()
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
 
+        // finished images uploaded, a few MB per frame at most
+        assets.update();
+
         ourShader.use();
-        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindTexture(GL_TEXTURE_2D, assets.texture(container));
         glBindVertexArray(VAO);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
@@ -0,0 +1,59 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+/*
+* Per-frame uniform block
+- Data every program needs once per frame, in one std140 uniform buffer:
+    layout (std140) uniform FrameUniforms
+    {
+        mat4 view;
+        mat4 projection;
+        mat4 viewProj;    // projection * view
+        vec3 cameraPos;   // world space
+        float time;       // seconds
+    };
+- Shaders declare it with #include "frame_uniforms.glsl" (see the preprocessor in shaders.h)
+- Every Shader declaring the block is wired to the FRAME_BLOCK binding point at link time (see shaders.h)
+- update(): written once per frame into the streaming ring buffer (see stream_buffer.h),
+  bound to FRAME_BLOCK at its offset -> one write instead of a setMat4 per matrix and program,
+  never overwrites the block a frame still in flight reads
+- The C++ struct mirrors the std140 layout: mat4 = 4 vec4 columns,
+  vec3 aligned to 16 bytes, the float after it fills the vec3's last 4 bytes
+*/
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "shaders.h"
+#include "stream_buffer.h"
+
+struct FrameData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProj;
+    glm::vec3 cameraPos;
+    float time;
+};
+
+static_assert(sizeof(FrameData) == 3 * 64 + 16, "FrameData must match the std140 layout of FrameUniforms");
+
+class FrameUniforms
+{
+public:
+    FrameData Data;
+
+    // once per frame, before the first draw, after stream.beginFrame()
+    void update(StreamBuffer &stream, const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &cameraPos, float time)
+    {
+        Data.view = view;
+        Data.projection = projection;
+        Data.viewProj = projection * view;
+        Data.cameraPos = cameraPos;
+        Data.time = time;
+        const GLintptr offset = stream.write(&Data, sizeof(FrameData), stream.UniformAlignment);
+        if (offset >= 0)
+            glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK, stream.buffer(), offset, sizeof(FrameData));
+    }
+};
+
+#endif
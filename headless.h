@@ -0,0 +1,203 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+/*
+* Headless rendering context
+- OpenGL 3.3 core context without a window or display server, through EGL
+  -> runs on machines without a GPU (Mesa llvmpipe), CI, render farms
+- Display: EGL_MESA_platform_surfaceless when available, else the default display
+- No window -> no default framebuffer, everything is drawn into an FBO
+  of width x height (RGBA8 color + 24-bit depth), bound after create()
+- finish(): replaces glfwSwapBuffers, waits until the frame is done so the
+  CPU timer measures the whole frame
+- writePPM(): color buffer as a binary PPM image (top row first)
+
+* Build
+- Only compiled with -DHEADLESS, link with -lEGL (GLFW not needed at run time)
+*/
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+
+class HeadlessContext
+{
+public:
+    int Width = 0;
+    int Height = 0;
+
+    HeadlessContext() {}
+    ~HeadlessContext() { destroy(); }
+    HeadlessContext(const HeadlessContext &) = delete;
+    HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+    // context + framebuffer of width x height, loads the GL functions through GLAD
+    bool create(int width, int height)
+    {
+        Width = width;
+        Height = height;
+        const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "ERROR::HEADLESS::DISPLAY_NOT_INITIALIZED" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::HEADLESS::OPENGL_API_NOT_SUPPORTED" << std::endl;
+            return false;
+        }
+
+        // a pbuffer capable config, only used when surfaceless contexts are not supported
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_NONE};
+        EGLConfig config = NULL;
+        EGLint numConfigs = 0;
+        eglChooseConfig(display, configAttributes, &config, 1, &numConfigs);
+        const char *displayExtensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (!numConfigs && !hasExtension(displayExtensions, "EGL_KHR_no_config_context"))
+        {
+            std::cout << "ERROR::HEADLESS::NO_CONFIG" << std::endl;
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE};
+        context = eglCreateContext(display, numConfigs ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cout << "ERROR::HEADLESS::CONTEXT_NOT_CREATED" << std::endl;
+            return false;
+        }
+        if (!hasExtension(displayExtensions, "EGL_KHR_surfaceless_context") && numConfigs)
+        {
+            const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context))
+        {
+            std::cout << "ERROR::HEADLESS::MAKE_CURRENT_FAILED" << std::endl;
+            return false;
+        }
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return false;
+        }
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        std::cout << "Headless: " << glGetString(GL_RENDERER) << ", EGL " << major << "." << minor << std::endl;
+        return true;
+    }
+
+    // end of frame
+    void finish() const { glFinish(); }
+
+    // color buffer -> binary PPM
+    bool writePPM(const std::string &path) const
+    {
+        std::vector<unsigned char> pixels((size_t)Width * Height * 4);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        FILE *stream = std::fopen(path.c_str(), "wb");
+        if (!stream)
+        {
+            std::cout << "ERROR::HEADLESS::IMAGE_NOT_WRITTEN " << path << std::endl;
+            return false;
+        }
+        std::fprintf(stream, "P6\n%d %d\n255\n", Width, Height);
+        // OpenGL rows start at the bottom
+        std::vector<unsigned char> row((size_t)Width * 3);
+        for (int y = Height - 1; y >= 0; y--)
+        {
+            const unsigned char *pixel = &pixels[(size_t)y * Width * 4];
+            for (int x = 0; x < Width; x++)
+            {
+                row[x * 3 + 0] = pixel[x * 4 + 0];
+                row[x * 3 + 1] = pixel[x * 4 + 1];
+                row[x * 3 + 2] = pixel[x * 4 + 2];
+            }
+            std::fwrite(row.data(), 1, row.size(), stream);
+        }
+        std::fclose(stream);
+        return true;
+    }
+
+    void destroy()
+    {
+        if (display == EGL_NO_DISPLAY)
+            return;
+        if (fbo)
+        {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(2, renderbuffers);
+            fbo = 0;
+        }
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        surface = EGL_NO_SURFACE;
+        context = EGL_NO_CONTEXT;
+    }
+
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    unsigned int fbo = 0;
+    unsigned int renderbuffers[2] = {0, 0};
+
+    // whole word match in a space separated extension list
+    static bool hasExtension(const char *extensions, const char *name)
+    {
+        if (!extensions)
+            return false;
+        const size_t length = std::strlen(name);
+        for (const char *found = std::strstr(extensions, name); found; found = std::strstr(found + 1, name))
+        {
+            if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+                return true;
+        }
+        return false;
+    }
+};
+
+#endif
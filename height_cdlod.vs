@@ -0,0 +1,47 @@
+#version 330 core
+// CDLOD: one shared grid patch, instanced once per selected quadtree node
+layout (location = 0) in vec2 aGridPos;  // patch vertex, 0 .. patch size
+layout (location = 1) in vec4 aNode;     // node origin (row, column), vertex spacing, level
+
+out float Height;
+out vec3 Position;
+
+uniform mat4 model;
+
+#include "frame_uniforms.glsl"
+
+uniform sampler2D heightMap;  // one texel per grid vertex, world space heights
+uniform vec2 gridOrigin;      // world (x, z) of grid vertex (0, 0)
+uniform vec2 gridSize;        // grid vertices (rows, columns)
+// LOD_MORPH: geomorphing between the levels, without it the level switches pop
+#ifdef LOD_MORPH
+uniform vec2 lodRange;        // x: range of level 0, y: morph start as fraction of the range
+#endif
+
+float sampleHeight(vec2 ij)
+{
+    // rows -> t, columns -> s, texel centers at +0.5
+    return texture(heightMap, (ij.yx + 0.5) / gridSize.yx).r;
+}
+
+void main()
+{
+    float spacing = aNode.z;
+    // grid position (row, column) of the vertex, clamped -> nodes past the edge collapse onto it
+    vec2 ij = min(aNode.xy + aGridPos * spacing, gridSize - 1.0);
+    vec3 world = vec3(gridOrigin.x + ij.x, sampleHeight(ij), gridOrigin.y + ij.y);
+
+#ifdef LOD_MORPH
+    // geomorph: odd patch vertices slide onto the next coarser grid as the range ends
+    float rangeEnd = lodRange.x * exp2(aNode.w);
+    float rangeStart = rangeEnd * lodRange.y;
+    float morph = clamp((distance(cameraPos, world) - rangeStart) / (rangeEnd - rangeStart), 0.0, 1.0);
+    vec2 odd = fract(aGridPos * 0.5) * 2.0;
+    ij = min(aNode.xy + (aGridPos - odd * morph) * spacing, gridSize - 1.0);
+    world = vec3(gridOrigin.x + ij.x, sampleHeight(ij), gridOrigin.y + ij.y);
+#endif
+
+    Height = world.y;
+    Position = (view * model * vec4(world, 1.0)).xyz;
+    gl_Position = viewProj * model * vec4(world, 1.0);
+}
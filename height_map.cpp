@@ -16,24 +16,112 @@
 #include <iostream>
 #include <cmath>
 #include <vector>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "shaders.h"
+#include "frame_uniforms.h"
+#include "stream_buffer.h"
+#include "shader_library.h"
 #include "camera.h"
+#include "camera_path.h"
+#include "triple_buffer.h"
+#include "terrain_mesh.h"
+#include "terrain_draw.h"
+#include "terrain_tiles.h"
+#include "terrain_lod.h"
+#include "terrain_cdlod.h"
+#include "terrain_rtin.h"
+#include "terrain_vertex.h"
+#include "terrain_grid.h"
+#include "terrain_heightmap.h"
+#include "asset_loader.h"
+#include "job_system.h"
+#include "profiler.h"
+#ifdef HEADLESS
+#include "headless.h"
+#endif
 
 // when user resizes the window -> viewport adjusted
+// callback on the input thread, glViewport on the thread with the context (applyViewport)
+std::atomic<int> viewportWidth(0);
+std::atomic<int> viewportHeight(0);
+std::atomic<bool> viewportChanged(false);
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    viewportWidth = width;
+    viewportHeight = height;
+    viewportChanged = true;
 }
+void applyViewport()
+{
+    if (viewportChanged.exchange(false))
+        glViewport(0, 0, viewportWidth, viewportHeight);
+}
+
+// draw submission mode, number keys 1-4 switch between them
+Draw_Mode drawMode = PER_STRIP;
+
+// terrain renderer, L switches between them, V toggles the LOD debug colors,
+// M the cdlod geomorphing
+enum Terrain_Mode {
+    GEOMIPMAP,
+    CDLOD,
+    RTIN,
+    FULL_RESOLUTION,
+    TILE_INDICES,
+    VERTEX_ID_GRID,
+    NUM_TERRAIN_MODES
+};
+const char *const TERRAIN_MODE_NAMES[NUM_TERRAIN_MODES] = {
+    "geomipmap",
+    "cdlod",
+    "rtin",
+    "full resolution",
+    "tile indices",
+    "vertex id grid"
+};
+Terrain_Mode terrainMode = GEOMIPMAP;
+bool lodDebug = false;
+bool lodMorph = true;
+// rtin: largest height difference to the full grid, [ and ] halve / double it
+float rtinMaxError = 1.0f;
+// vertex format of the full grid, F cycles through them
+Vertex_Format vertexFormat = VERTEX_FLOAT3;
 
-// input control in GLFW
-void processInput(GLFWwindow *window)
+// toggles, once per key press
+void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(window, true);
+    if (action != GLFW_PRESS)
+        return;
+    if (key == GLFW_KEY_L)
+    {
+        terrainMode = (Terrain_Mode)((terrainMode + 1) % NUM_TERRAIN_MODES);
+        std::cout << "Terrain: " << TERRAIN_MODE_NAMES[terrainMode] << std::endl;
+    }
+    if (key == GLFW_KEY_V)
+        lodDebug = !lodDebug;
+    if (key == GLFW_KEY_M)
+    {
+        lodMorph = !lodMorph;
+        std::cout << "CDLOD geomorphing " << (lodMorph ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_F)
+    {
+        vertexFormat = (Vertex_Format)((vertexFormat + 1) % NUM_VERTEX_FORMATS);
+        std::cout << "Vertex format: " << VERTEX_FORMAT_NAMES[vertexFormat] << std::endl;
+    }
+    if (key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET)
+        rtinMaxError *= key == GLFW_KEY_LEFT_BRACKET ? 0.5f : 2.0f;
 }
 
 // camera - give pretty starting point
@@ -45,155 +133,667 @@ Camera camera(glm::vec3(67.0f, 627.5f, 169.9f),
 float lastX = SCR_WIDTH / 2.0f;
 float lastY = SCR_HEIGHT / 2.0f;
 
-int main()
+// input control in GLFW, once per simulation step
+// WASD: move, mouse with the right button held: look around
+void processInput(GLFWwindow *window, float deltaTime)
 {
-    // ==================================================================================== //
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(window, true);
+    for (int mode = 0; mode < NUM_DRAW_MODES; mode++)
+    {
+        if (glfwGetKey(window, GLFW_KEY_1 + mode) == GLFW_PRESS)
+            drawMode = (Draw_Mode)mode;
+    }
+    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+        camera.ProcessKeyboard(FORWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+        camera.ProcessKeyboard(BACKWARD, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+        camera.ProcessKeyboard(LEFT, deltaTime);
+    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+        camera.ProcessKeyboard(RIGHT, deltaTime);
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
+        camera.ProcessMouseMovement((float)x - lastX, lastY - (float)y); // y goes down on screen
+    lastX = (float)x;
+    lastY = (float)y;
+}
+
+// input / simulation: the camera and the toggles belong to the main thread, which handles
+// the input at SIM_RATE steps; the render thread draws the latest published copy
+// (see triple_buffer.h) -> a slow frame does not hold up the input, the next frame never
+// waits for the input thread
+const double SIM_RATE = 120.0;
+struct SimState
+{
+    Camera camera;
+    Terrain_Mode terrainMode;
+    Draw_Mode drawMode;
+    Vertex_Format vertexFormat;
+    bool lodDebug;
+    bool lodMorph;
+    float rtinMaxError;
+};
+TripleBuffer<SimState> simStates;
+
+// input thread: copy of the current state for the render thread
+void publishSimState()
+{
+    SimState &state = simStates.write();
+    state.camera = camera;
+    state.terrainMode = terrainMode;
+    state.drawMode = drawMode;
+    state.vertexFormat = vertexFormat;
+    state.lodDebug = lodDebug;
+    state.lodMorph = lodMorph;
+    state.rtinMaxError = rtinMaxError;
+    simStates.publish();
+}
+
+// terrain tiles of TILE_SIZE x TILE_SIZE quads, culled against the view frustum
+// and drawn at a level of detail chosen per tile (power of two)
+const unsigned int TILE_SIZE = 64;
 
-    GLFWwindow *window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
+// seconds since the first call, same clock with and without a window
+double seconds()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// mesh and rtin error map from the samples of the height map, in their own type
+// -> the error map is one job, the mesh rows are split over the others (see job_system.h)
+template <typename Sample>
+void buildTerrain(const HeightMap &heightMap, TerrainMeshBuilder &mesh, TerrainRTIN &rtin)
+{
+    const Sample *data = (const Sample *)heightMap.data();
+    JobSystem::JobHandle rtinJob = JobSystem::shared().run([&] { rtin.build(data, heightMap.Width, heightMap.Height, 1); });
+    mesh.build(data, heightMap.Width, heightMap.Height, 1);
+    JobSystem::shared().wait(rtinJob);
+}
+
+// usage: height_map [height map path] [--headless frames] [--image path.ppm]
+//                   [--mode terrain mode] [--draw draw mode] [--format vertex format]
+//                   [--csv path.csv] [--path camera.path] [--step seconds] [--results path.csv]
+//                   [--no-shader-cache]
+// headless: no window, renders frames into an offscreen framebuffer, prints the
+//           frame times and writes the last frame as an image (built with -DHEADLESS -lEGL)
+// csv: cpu / gpu time, draw calls, triangles and scope times of every frame (see profiler.h)
+// path: flythrough benchmark, the camera follows the keyframes of the file at a fixed
+//       timestep (default 1/60 s), frames: headless count or one pass over the path,
+//       frame times per path segment printed / written to the results file (see camera_path.h)
+// no-shader-cache: always compile the shaders, no program binaries read or written (see program_cache.h)
+// modes / formats by number, in the order of the L / 1-4 / F keys
+int main(int argc, char *argv[])
+{
+    const char *heightMapPath = "./img/iceland_heightmap.png";
+    bool headless = false;
+    unsigned long headlessFrames = 0;
+    const char *imagePath = NULL;
+    const char *csvPath = NULL;
+    const char *cameraPathFile = NULL;
+    float pathStep = 1.0f / 60.0f;
+    const char *resultsPath = NULL;
+    bool shaderCache = true;
+    for (int a = 1; a < argc; a++)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        const bool hasValue = a + 1 < argc;
+        if (!std::strcmp(argv[a], "--headless") && hasValue)
+        {
+            headless = true;
+            headlessFrames = std::strtoul(argv[++a], NULL, 10);
+        }
+        else if (!std::strcmp(argv[a], "--image") && hasValue)
+            imagePath = argv[++a];
+        else if (!std::strcmp(argv[a], "--mode") && hasValue)
+            terrainMode = (Terrain_Mode)(std::atoi(argv[++a]) % NUM_TERRAIN_MODES);
+        else if (!std::strcmp(argv[a], "--draw") && hasValue)
+            drawMode = (Draw_Mode)(std::atoi(argv[++a]) % NUM_DRAW_MODES);
+        else if (!std::strcmp(argv[a], "--format") && hasValue)
+            vertexFormat = (Vertex_Format)(std::atoi(argv[++a]) % NUM_VERTEX_FORMATS);
+        else if (!std::strcmp(argv[a], "--csv") && hasValue)
+            csvPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--path") && hasValue)
+            cameraPathFile = argv[++a];
+        else if (!std::strcmp(argv[a], "--step") && hasValue)
+            pathStep = (float)std::atof(argv[++a]);
+        else if (!std::strcmp(argv[a], "--results") && hasValue)
+            resultsPath = argv[++a];
+        else if (!std::strcmp(argv[a], "--no-shader-cache"))
+            shaderCache = false;
+        else
+            heightMapPath = argv[a];
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); // after window creation, before render function
 
-    // GLAD manages function pointers for OpenGL
-    // -> initialize GLAD before we call any OpenGL function
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) // pass the address of the OpenGL function pointers (given by OpenGL)
+    // flythrough: keyframes loaded before any window is opened
+    CameraPath cameraPath;
+    if (cameraPathFile && !cameraPath.load(cameraPathFile))
+        return -1;
+    if (cameraPathFile && pathStep <= 0.0f)
+    {
+        std::cout << "ERROR::HEIGHT_MAP::INVALID_STEP " << pathStep << std::endl;
+        return -1;
+    }
+    CameraPathBenchmark pathBenchmark(cameraPath);
+    // frames to render, 0 -> until the window is closed
+    unsigned long runFrames = headlessFrames;
+    if (cameraPathFile && !runFrames)
+        runFrames = (unsigned long)(cameraPath.duration() / pathStep) + 1;
+    if (headless && !runFrames)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
+        std::cout << "ERROR::HEIGHT_MAP::NO_FRAMES (--headless needs a frame count or a camera path)" << std::endl;
         return -1;
     }
+    if (imagePath && !headless)
+        std::cout << "--image ignored: the last frame is only written by a --headless run" << std::endl;
+
+    // height map read on the loader thread while the context is created and the shaders
+    // are submitted, the GL thread only picks it up (see asset_loader.h)
+    AssetLoader assets;
+    const unsigned int heightMapAsset = assets.loadHeightMap(heightMapPath);
 
     // ==================================================================================== //
-    // Height map
-    int width, height, nChannels;
-    unsigned char *data = stbi_load("./img/iceland_heightmap.png", &width, &height, &nChannels, 0);
-    if(data)
+    GLFWwindow *window = NULL;
+#ifdef HEADLESS
+    HeadlessContext headlessContext;
+#endif
+    // startup phases and frame stats, summary on exit (see profiler.h)
+    Profiler profiler;
+    profiler.begin("create context");
+    // GL function loader of the context, also used for functions GLAD does not load
+    GLADloadproc glLoader = NULL;
+    if (headless)
     {
-        // check if properly loaded?
+#ifdef HEADLESS
+        // context + offscreen framebuffer, GLAD loaded through EGL (see headless.h)
+        if (!headlessContext.create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
+        glLoader = (GLADloadproc)eglGetProcAddress;
+#else
+        std::cout << "ERROR::HEIGHT_MAP::HEADLESS_NOT_BUILT (compile with -DHEADLESS -lEGL)" << std::endl;
+        return -1;
+#endif
     }
     else
     {
-        std::cout << "Failed to load texture" << std::endl;
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+        window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); // after window creation, before render function
+        glfwSetKeyCallback(window, key_callback);
+
+        // GLAD manages function pointers for OpenGL
+        // -> initialize GLAD before we call any OpenGL function
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) // pass the address of the OpenGL function pointers (given by OpenGL)
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        glLoader = (GLADloadproc)glfwGetProcAddress;
     }
+    // linked programs kept between launches
+    if (shaderCache)
+        ProgramCache::enable(glLoader, "./shader_cache");
+    profiler.end();
 
-    // Generate a mesh that matched the resolution of our image
-    // Populate each mesh vertex as follows
-    std::vector<float> vertices;
+    // every program submitted now, the driver compiles them while the height map
+    // is loaded and the mesh is built, waited for on first use (see shader_library.h)
+    profiler.begin("submit shaders");
+    // permutations (see the preprocessor in shaders.h): the vertex format and the LOD tint
+    // are compiled in, no per vertex / fragment branch on a uniform
+    ShaderLibrary shaders(glLoader);
+    unsigned int terrainPrograms[NUM_VERTEX_FORMATS][2];
+    for (int format = 0; format < NUM_VERTEX_FORMATS; format++)
+    {
+        for (int debug = 0; debug < 2; debug++)
+        {
+            std::vector<std::string> defines = {"VERTEX_FORMAT " + std::to_string(format)};
+            if (debug)
+                defines.push_back("LOD_DEBUG");
+            terrainPrograms[format][debug] = shaders.add("./height_shader.vs", "./height_shader.fs", defines);
+        }
+    }
+    // vertex id grid: texture format, (row, column) from gl_VertexID for tiles of TILE_SIZE quads
+    const unsigned int gridProgram = shaders.add("./height_shader.vs", "./height_shader.fs",
+        {"VERTEX_FORMAT " + std::to_string(VERTEX_TEXTURE), "VERTEX_ID_GRID " + std::to_string(TILE_SIZE)});
+    // same fragment stage, vertices from the instanced patch, with / without geomorphing
+    unsigned int cdlodPrograms[2][2];
+    for (int morph = 0; morph < 2; morph++)
+    {
+        for (int debug = 0; debug < 2; debug++)
+        {
+            std::vector<std::string> defines;
+            if (morph)
+                defines.push_back("LOD_MORPH");
+            if (debug)
+                defines.push_back("LOD_DEBUG");
+            cdlodPrograms[morph][debug] = shaders.add("./height_cdlod.vs", "./height_shader.fs", defines);
+        }
+    }
+    profiler.end();
 
-    float yScale = 64.0f / 256.0f, yShift = 16.0f; // apply a scale+shift to the height data -> why???
-    for(unsigned int i = 0; i < height ; i++)
+    // ==================================================================================== //
+    // Height map
+    // decoded once, later launches mmap the binary cache next to the image (see terrain_heightmap.h)
+    // 8-bit / 16-bit / float samples, optional path: height_map [height map path]
+    profiler.begin("load height map");
+    // window: placeholder frames until the height map arrives -> the window shows up at once
+    // and stays responsive, headless: nothing to show, just wait
+    while (window && !assets.ready(heightMapAsset) && !assets.failed(heightMapAsset))
     {
-        for(unsigned int j=0; j<width ; j++)
+        // no terrain to move over yet
+        processInput(window, 0.0f);
+        if (glfwWindowShouldClose(window))
         {
-            // retrieve texel for (i, j) coord
-            unsigned char* texel = data + (j + width * i) * nChannels;
-            // raw height at coordinate
-            unsigned char y = texel[0]; // grayscale, all values in the channels are same
-
-            // store all coordinate in one array -> size of width * height * 3
-            vertices.push_back(-(height/2.0f) + i);
-            vertices.push_back((int)y * yScale - yShift);
-            vertices.push_back(-(width/2.0f) + j);
+            glfwTerminate();
+            return 0;
         }
+        assets.update();
+        shaders.poll();
+        applyViewport();
+        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    if (!assets.wait(heightMapAsset))
+    {
+        std::cout << "Failed to load texture" << std::endl;
+        if (window)
+            glfwTerminate();
+        return -1;
     }
-    stbi_image_free(data); // good practice to free memory after reading information
+    HeightMap &heightMap = *assets.heightMap(heightMapAsset);
+    std::cout << "Height map " << (heightMap.FromCache ? "mapped from cache" : "decoded, cache written")
+              << ", " << heightMap.Format * 8 << "-bit samples" << std::endl;
+    profiler.end();
+    shaders.poll();
+
+    // Generate a mesh that matched the resolution of our image
+    // vertices: populate each mesh vertex with (x, scaled height, z)
+    // indices:  Element Buffer Object (EBO) to connect the vertices into triangles,
+    //           alternate between row i and i+1 as we sweep across all columns j
+    // -> both are filled in parallel, bands of rows as jobs (see terrain_mesh.h)
+    // -> strips are grouped by tile, so invisible tiles can be skipped
+    // -> grid padded to whole tiles, every tile shares the same LOD index patterns
+    // -> indices are only built when the full resolution strips are first drawn,
+    //    every other mode derives its triangles from (row, column)
+    profiler.begin("build mesh");
+    TerrainMeshBuilder mesh(NULL, TILE_SIZE);
+    mesh.padToTiles = true;
+    // strips of 15 quads -> the shared row stays in a 32 entry vertex cache (see terrain_cache_bench.cpp)
+    mesh.stripWidth = 15;
+    mesh.withIndices = false;
+    // sample range -> [-16, 48], whatever the bit depth
+    float low, high;
+    heightMap.range(low, high);
+    mesh.fitHeights(low, high);
+    // rtin: error map over the same data, meshes are extracted per error threshold (see terrain_rtin.h)
+    TerrainRTIN rtin;
+    rtin.yScale = mesh.yScale;
+    rtin.yShift = mesh.yShift;
+    // single channel samples, used in place
+    if (heightMap.Format == SAMPLE_U8)
+        buildTerrain<unsigned char>(heightMap, mesh, rtin);
+    else if (heightMap.Format == SAMPLE_U16)
+        buildTerrain<unsigned short>(heightMap, mesh, rtin);
+    else
+        buildTerrain<float>(heightMap, mesh, rtin);
+    heightMap.close(); // good practice to free memory after reading information
+    profiler.end();
+    shaders.poll();
+    std::vector<float> &vertices = mesh.vertices;
     std::cout << "Loaded " << vertices.size() / 3 << " vertices" << std::endl;
     std::cout << vertices.size() << std::endl;
 
     // ! Why scale & shift y value?
-    // y value from image -> within range of [0, 256]
+    // y value from image -> within range of [low, high] of its samples
+    //                       (8-bit [0, 256), 16-bit [0, 65536), float anything)
     // Scale?
     //      - normalize the height map data to be within the range [0.0f, 1.0f]
     //      - scale it to the desired height we wish to work with
     // Shift?
     //      - translate the elevations to our final desired range, [-16.0f, 48.0f]
 
+    // Each strip of n indices will be comprised of n - 2 triangles
+    // one strip per tile row, (TILE_SIZE + 1) * 2 indices for full tiles
+    std::cout << mesh.numStrips() << " strips in " << mesh.numBatches() << " tiles" << std::endl;
 
-    // Element Buffer Object (EBO) to connect the vertices into triangles
-    // alternate between row i and i+1 as we sweep across all columns j
-    std::vector<unsigned int> indices;
-    for(unsigned int i=0; i<height-1; i++)
-    {
-        for(unsigned int j=0; j<width ; j++)
+    // bounding box per tile for culling
+    profiler.begin("build renderers");
+    TerrainTiles tiles(vertices, mesh.width(), mesh.height(), TILE_SIZE);
+
+    // vertex buffers of every vertex format, F switches between them (see terrain_vertex.h)
+    // float3 is the (x, y, z) array above, the compact formats keep only the height
+    TerrainVertices terrainVertices(vertices, mesh.width(), mesh.height());
+    terrainVertices.printReport();
+
+    // full resolution: index buffers for every draw mode (see terrain_draw.h), created on first use
+    std::unique_ptr<TerrainDraw> terrainDraw;
+    // full resolution without the big index buffers: one shared tile index buffer,
+    // or no index buffer at all (see terrain_grid.h)
+    TerrainGrid terrainGrid(mesh.width(), mesh.height(), TILE_SIZE);
+    std::cout << "Index memory: strips " << mesh.numStrips() * (TILE_SIZE + 1) * 2 * sizeof(unsigned int) / (1024 * 1024)
+              << " MB per draw mode, shared tile " << terrainGrid.indexBytes() / 1024 << " KB, vertex id grid 0" << std::endl;
+    // geomipmap: index patterns per level, geometric error per tile (see terrain_lod.h)
+    TerrainLOD terrainLOD(vertices, mesh.width(), mesh.height(), TILE_SIZE);
+    std::cout << terrainLOD.numLevels() << " LOD levels, budget "
+              << terrainLOD.TriangleBudget << " triangles" << std::endl;
+    // cdlod: quadtree of nodes, one shared patch drawn instanced, heights from a texture (see terrain_cdlod.h)
+    std::vector<float> heights(vertices.size() / 3);
+    for (size_t v = 0; v < heights.size(); v++)
+        heights[v] = vertices[v * 3 + 1];
+    TerrainCDLOD terrainCDLOD(heights, mesh.width(), mesh.height(), glm::vec2(vertices[0], vertices[2]), TILE_SIZE);
+    std::cout << terrainCDLOD.numLevels() << " CDLOD levels" << std::endl;
+    profiler.end();
+
+    // Simple shader
+    // model matrix handle of every program, looked up on the program's first use
+    // (the rest is set by the renderers) -> a permutation never drawn is never waited for
+    std::vector<Uniform<glm::mat4>> modelUniforms(shaders.size());
+    std::vector<bool> modelResolved(shaders.size(), false);
+    // data rewritten every frame (instances, per-frame block), one ring buffer for all of it
+    StreamBuffer stream(glLoader, 2 * 1024 * 1024);
+    // view, projection, camera position, time of every program
+    FrameUniforms frameUniforms;
+    if (csvPath)
+        profiler.openCSV(csvPath);
+
+    // window: the context moves to the render thread, this thread handles the input
+    // headless: no input, the render loop runs right here
+    camera.MovementSpeed = 200.0f;
+    publishSimState();
+    std::atomic<bool> rendering(true);
+    // title with the render thread's stats, set on the input thread (GLFW wants it there)
+    std::mutex titleMutex;
+    std::string windowTitle;
+    double lastFrame = seconds();
+    const double startTime = lastFrame;
+    double lastTitle = lastFrame;
+    unsigned long titleFrames = 0;
+    // headless: time of every frame
+    std::vector<double> frameTimes;
+    frameTimes.reserve(runFrames);
+    unsigned long frame = 0;
+    // rtin threshold of the extracted mesh
+    float extractedError = -1.0f;
+
+    const auto renderLoop = [&] {
+        if (window)
         {
-            for(unsigned int k=0; k<2; k++)
+            glfwMakeContextCurrent(window);
+            // no vsync -> frame times show the cost of each draw mode
+            glfwSwapInterval(0);
+        }
+        while ((!window || !glfwWindowShouldClose(window)) && (!runFrames || frame < runFrames))
+        {
+            profiler.beginFrame();
+            applyViewport();
+            // latest state of the input thread, the same for the whole frame
+            // (the locals shadow the input thread's globals)
+            const SimState &sim = simStates.read();
+            Camera frameCamera = sim.camera;
+            const Terrain_Mode terrainMode = sim.terrainMode;
+            const Draw_Mode drawMode = sim.drawMode;
+            const Vertex_Format vertexFormat = sim.vertexFormat;
+            const bool lodDebug = sim.lodDebug;
+            const bool lodMorph = sim.lodMorph;
+            // flythrough: pose of this frame's simulated time, repeats the path after its end
+            float pathTime = 0.0f;
+            if (cameraPathFile)
             {
-                indices.push_back(j + width * (i + k));
+                float elapsed = frame * pathStep;
+                if (elapsed > cameraPath.duration())
+                    elapsed = std::fmod(elapsed, cameraPath.duration());
+                pathTime = cameraPath.Keyframes[0].time + elapsed;
+                CameraKeyframe pose = cameraPath.sample(pathTime);
+                frameCamera.SetPose(pose.position, pose.yaw, pose.pitch);
             }
-        }
-    }
-
-    // Two values need to know when rendering
-    const unsigned int NUM_STRIPS = height - 1;
-    const unsigned int NUM_VERTS_PER_STRIP = width * 2;
-    // Each strip will be comprised of NUM_VERTS_PER_STRIP - 2 triangles
-    // Full mesh will contain NUM_STRIPS * (NUM_VERTS_PER_STRIP - 2)
 
-    GLuint terrainVAO, terrainVBO, terrainEBO;
-    glGenVertexArrays(1, &terrainVAO);
-    glBindVertexArray(terrainVAO);
+            // rendering commands here
+            // permutation of this frame's renderer: vertex format compiled in,
+            // LOD tint only where there are levels
+            unsigned int program;
+            if (terrainMode == CDLOD)
+                program = cdlodPrograms[lodMorph][lodDebug];
+            else if (terrainMode == VERTEX_ID_GRID)
+                program = gridProgram;
+            else
+            {
+                // rtin: own (x, y, z) float buffer
+                const Vertex_Format format = terrainMode == RTIN ? VERTEX_FLOAT3 : vertexFormat;
+                program = terrainPrograms[format][lodDebug && terrainMode == GEOMIPMAP];
+            }
+            Shader &shader = shaders.get(program);
+            if (!modelResolved[program])
+            {
+                modelUniforms[program] = shader.uniform<glm::mat4>("model");
+                modelResolved[program] = true;
+            }
+            shader.use();
+            // view/projection transformations
+            glm::mat4 projection = glm::perspective(glm::radians(frameCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100000.0f);
+            glm::mat4 view = frameCamera.GetViewMatrix();
+            // one buffer write for every program (see frame_uniforms.h)
+            // flythrough: simulated time -> same frame content every run
+            stream.beginFrame();
+            frameUniforms.update(stream, view, projection, frameCamera.Position, cameraPathFile ? pathTime : (float)(seconds() - startTime));
 
-    glGenBuffers(1, &terrainVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
-    glBufferData(GL_ARRAY_BUFFER,
-                 vertices.size() * sizeof(float), // size of vertices buffer
-                 &vertices[0],                    // pointer to first element 
-                 GL_STATIC_DRAW);
+            // world transformation
+            glm::mat4 model = glm::mat4(1.0f);
+            shader.set(modelUniforms[program], model);
 
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-    glEnableVertexAttribArray(0);
+            // skip tiles outside the view frustum
+            profiler.begin("cull");
+            tiles.cull(Frustum(projection * view * model));
+            profiler.end();
+            unsigned int drawCalls;
+            // full grid modes: two triangles per quad of every visible tile
+            unsigned long long triangles = (unsigned long long)tiles.Visible.size() * TILE_SIZE * TILE_SIZE * 2;
+            profiler.begin("draw");
+            profiler.beginGpu();
+            if (terrainMode == CDLOD)
+            {
+                // nodes refined by distance to the camera, morphing hides the level switches
+                terrainCDLOD.select(frameCamera.Position, Frustum(projection * view * model));
+                if (lodDebug)
+                    terrainCDLOD.drawDebug(shader, stream, LOD_COLORS, 8);
+                else
+                    terrainCDLOD.draw(shader, stream);
+                drawCalls = terrainCDLOD.DrawCalls;
+                triangles = terrainCDLOD.Triangles;
+            }
+            else if (terrainMode == RTIN)
+            {
+                // re-triangulate only when the threshold changes, the mesh itself is static
+                if (sim.rtinMaxError != extractedError)
+                {
+                    extractedError = sim.rtinMaxError;
+                    rtin.extract(extractedError);
+                    rtin.upload();
+                    std::cout << "RTIN max error " << extractedError << ": " << rtin.numTriangles() << " triangles, "
+                              << rtin.numVertices() << " vertices" << std::endl;
+                }
+                rtin.draw();
+                drawCalls = 1;
+                triangles = rtin.numTriangles();
+            }
+            else if (terrainMode == GEOMIPMAP)
+            {
+                terrainVertices.bind(vertexFormat, shader);
+                // level per tile from its screen space error, within the triangle budget
+                terrainLOD.select(frameCamera.Position, glm::radians(frameCamera.Zoom), (float)SCR_HEIGHT, tiles.Visible);
+                if (lodDebug)
+                    terrainLOD.drawDebug(shader);
+                else
+                    terrainLOD.draw(drawMode == MULTI_DRAW);
+                drawCalls = terrainLOD.DrawCalls;
+                triangles = terrainLOD.Triangles;
+            }
+            else if (terrainMode == TILE_INDICES)
+            {
+                terrainVertices.bind(vertexFormat, shader);
+                terrainGrid.drawTileIndices(tiles.Visible);
+                drawCalls = terrainGrid.DrawCalls;
+            }
+            else if (terrainMode == VERTEX_ID_GRID)
+            {
+                terrainVertices.bind(VERTEX_TEXTURE, shader);
+                terrainGrid.drawVertexID(tiles.Visible, stream);
+                drawCalls = terrainGrid.DrawCalls;
+            }
+            else
+            {
+                if (!terrainDraw)
+                {
+                    mesh.buildIndices();
+                    terrainDraw.reset(new TerrainDraw(mesh.indices, mesh.stripCounts, mesh.batchStrips, drawMode));
+                }
+                terrainDraw->setMode(drawMode);
+                terrainVertices.bind(vertexFormat, shader);
+                terrainDraw->draw(tiles.Visible);
+                drawCalls = terrainDraw->DrawCalls;
+            }
+            stream.endFrame();
+            profiler.endGpu();
+            profiler.end();
 
-    glGenBuffers(1, &terrainEBO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indices.size() * sizeof(unsigned int), // size of indices buffer
-                 &indices[0],                           // pointer to first element
-                 GL_STATIC_DRAW);
+            // swap the buffers, events are polled on the input thread
+            profiler.begin("swap");
+            if (window)
+                glfwSwapBuffers(window);
+#ifdef HEADLESS
+            else
+                headlessContext.finish();
+#endif
+            profiler.end();
+            profiler.endFrame(drawCalls, triangles);
 
-    glBindVertexArray(terrainVAO);
+            // draw mode comparison only covers the full resolution strips
+            double currentFrame = seconds();
+            if (headless)
+                frameTimes.push_back(currentFrame - lastFrame);
+            // first frame includes lazy setup, not part of the segment stats
+            if (cameraPathFile && frame > 0)
+                pathBenchmark.record(pathTime, (currentFrame - lastFrame) * 1000.0, drawCalls, triangles);
+            frame++;
+            if (terrainMode == FULL_RESOLUTION)
+                terrainDraw->recordFrame(currentFrame - lastFrame);
+            lastFrame = currentFrame;
 
-    // Simple shader
-    Shader ourShader("./height_shader.vs", "./height_shader.fs");
+            // frame time and culling stats in the title, refreshed twice a second
+            titleFrames++;
+            if (window && currentFrame - lastTitle >= 0.5)
+            {
+                std::string title = "LearnOpenGL - " + std::string(TERRAIN_MODE_NAMES[terrainMode])
+                    + ", " + DRAW_MODE_NAMES[drawMode] + ", " + VERTEX_FORMAT_NAMES[vertexFormat]
+                    + " | " + std::to_string((currentFrame - lastTitle) * 1000.0 / titleFrames) + " ms"
+                    + " | tiles visible " + std::to_string(tiles.Visible.size())
+                    + " culled " + std::to_string(tiles.CulledTiles)
+                    + " | draws " + std::to_string(drawCalls);
+                if (terrainMode == GEOMIPMAP)
+                    title += " | triangles " + std::to_string(terrainLOD.Triangles);
+                if (terrainMode == RTIN)
+                    title += " | max error " + std::to_string(extractedError)
+                        + " | triangles " + std::to_string(rtin.numTriangles());
+                if (terrainMode == CDLOD)
+                    title += " | nodes " + std::to_string(terrainCDLOD.SelectedNodes)
+                        + " | triangles " + std::to_string(terrainCDLOD.Triangles);
+                {
+                    std::lock_guard<std::mutex> lock(titleMutex);
+                    windowTitle = title;
+                }
+                lastTitle = currentFrame;
+                titleFrames = 0;
+            }
+        }
+        if (window)
+            glfwMakeContextCurrent(NULL);
+        rendering = false;
+    };
 
-    while (!glfwWindowShouldClose(window))
+    if (window)
     {
-        // input
-        processInput(window);
-
-        // rendering commands here
-        ourShader.use();
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100000.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // world transformation
-        glm::mat4 model = glm::mat4(1.0f);
-        ourShader.setMat4("model", model);
-        for(unsigned int strip = 0; strip < NUM_STRIPS; ++strip)
+        glfwMakeContextCurrent(NULL);
+        std::thread renderThread(renderLoop);
+        const double step = 1.0 / SIM_RATE;
+        double nextStep = seconds();
+        while (rendering)
         {
-            // draw strip by strip
-            glDrawElements(GL_TRIANGLE_STRIP,
-                           NUM_VERTS_PER_STRIP,
-                           GL_UNSIGNED_INT,
-                           (void*)(sizeof(unsigned int)
-                                        * NUM_VERTS_PER_STRIP
-                                        * strip));
+            // toggles and resizes as their events come in, held keys / mouse once per step
+            glfwWaitEventsTimeout(std::max(0.0, nextStep - seconds()));
+            if (seconds() < nextStep)
+                continue;
+            processInput(window, (float)step);
+            publishSimState();
+            {
+                std::lock_guard<std::mutex> lock(titleMutex);
+                if (!windowTitle.empty())
+                    glfwSetWindowTitle(window, windowTitle.c_str());
+                windowTitle.clear();
+            }
+            nextStep += step;
+            // far behind (window dragged, ...) -> no burst of catch-up steps
+            if (seconds() - nextStep > 0.25)
+                nextStep = seconds() + step;
         }
-        // Check and call events and swap the buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        renderThread.join();
+        glfwMakeContextCurrent(window);
+        std::cout << "Simulation: " << simStates.Published << " steps at " << SIM_RATE << " Hz, "
+                  << simStates.Consumed << " new states drawn in " << frame << " frames" << std::endl;
+    }
+    else
+        renderLoop();
+
+    if (terrainDraw)
+        terrainDraw->printReport();
+    // programs ready before their first use: known only once the frames have used them
+    shaders.printReport();
+    if (ProgramCache::enabled())
+        std::cout << "Program cache: " << ProgramCache::Hits << " loaded, " << ProgramCache::Misses << " compiled" << std::endl;
+    stream.printReport();
+    assets.printReport();
+    JobSystem::shared().printReport();
+    profiler.printSummary();
+    if (cameraPathFile)
+    {
+        pathBenchmark.printReport();
+        if (resultsPath)
+            pathBenchmark.writeResults(resultsPath);
+    }
+
+    if (headless)
+    {
+        // first frame includes lazy setup (rtin extraction, full resolution indices)
+        std::vector<double> sorted(frameTimes.begin() + 1, frameTimes.end());
+        if (sorted.empty())
+            sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double t : sorted)
+            total += t;
+        std::cout << "Headless " << TERRAIN_MODE_NAMES[terrainMode] << ", " << DRAW_MODE_NAMES[drawMode]
+                  << ", " << VERTEX_FORMAT_NAMES[vertexFormat] << ": " << frameTimes.size() << " frames, first "
+                  << frameTimes[0] * 1000.0 << " ms, then mean " << total * 1000.0 / sorted.size()
+                  << " ms, min " << sorted.front() * 1000.0 << " ms, median " << sorted[sorted.size() / 2] * 1000.0
+                  << " ms, max " << sorted.back() * 1000.0 << " ms" << std::endl;
+#ifdef HEADLESS
+        if (imagePath)
+            headlessContext.writePPM(imagePath);
+#endif
+        return 0;
     }
 
     // As soon as we exit the render loop,
@@ -1,8 +1,19 @@
 #version 330 core
 out vec4 FragColor;
 in float Height;
+
+#include "terrain_shade.glsl"
+
+// LOD_DEBUG: tint by the level of the tile
+#ifdef LOD_DEBUG
+uniform vec3 lodColor;
+#endif
+
 void main()
 {
-    float h = (Height + 16) / 32.0f;
+    float h = heightShade(Height);
     FragColor = vec4(h, h, h, 1.0f);
-}
\ No newline at end of file
+#ifdef LOD_DEBUG
+    FragColor.rgb = lodColor * (0.35 + 0.65 * clamp(h, 0.0, 1.0));
+#endif
+}
@@ -1,17 +1,59 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
+layout (location = 0) in vec3 aPos;     // float3 format
+layout (location = 1) in float aHeight; // height16 format, normalized
+layout (location = 2) in vec2 aTile;    // vertex id grid: first (row, column) of the tile
 
 out float Height;
 out vec3 Position;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
+#include "frame_uniforms.glsl"
+
+// vertex format (see terrain_vertex.h), compiled in: 0 float3, 1 height16, 2 texture
+#ifndef VERTEX_FORMAT
+#define VERTEX_FORMAT 0
+#endif
+uniform int gridWidth;        // vertices per grid row
+uniform vec2 gridOrigin;      // world (x, z) of grid vertex 0
+uniform vec2 heightRange;     // x: min height, y: max - min
+uniform sampler2D heightMap;  // texture format, R16, one texel per vertex
+// VERTEX_ID_GRID <tile quads>: vertex id grid (see terrain_grid.h), no index buffer
 
 void main()
 {
-    Height = aPos.y;
-    Position = (view * model * vec4(aPos, 1.0)).xyz;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    // grid vertex index, from the index buffer or built from the vertex / tile ids
+    int v = gl_VertexID;
+#ifdef VERTEX_ID_GRID
+    {
+        int rowLength = 2 * VERTEX_ID_GRID + 4;
+        int r = gl_VertexID / rowLength;
+        int m = gl_VertexID - r * rowLength;
+        if (m == rowLength - 1)
+        {
+            r += 1;
+            m = 0;
+        }
+        m = min(m, rowLength - 3);
+        ivec2 ij = ivec2(aTile) + ivec2(r + (m & 1), m >> 1);
+        v = ij.x * gridWidth + ij.y;
+    }
+#endif
+
+#if VERTEX_FORMAT == 0
+    vec3 pos = aPos;
+#else
+    // grid position from the vertex index, height from the attribute or the texture
+    int i = v / gridWidth;
+    int j = v - i * gridWidth;
+#if VERTEX_FORMAT == 1
+    float h = aHeight;
+#else
+    float h = texelFetch(heightMap, ivec2(j, i), 0).r;
+#endif
+    vec3 pos = vec3(gridOrigin.x + float(i), heightRange.x + h * heightRange.y, gridOrigin.y + float(j));
+#endif
+    Height = pos.y;
+    Position = (view * model * vec4(pos, 1.0)).xyz;
+    gl_Position = viewProj * model * vec4(pos, 1.0);
+}
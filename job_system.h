@@ -0,0 +1,296 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+/*
+* Work-stealing job system
+- One pool of worker threads for all CPU work (mesh building, tile errors, text parsing,
+  image decoding, ...), instead of every step starting and joining its own threads
+- JobSystem(threads): threads - 1 workers, the thread that waits is the last one
+  -> JobSystem(1) has no workers, everything runs in the calling thread
+- shared(): the pool every subsystem uses by default, one thread per hardware thread
+
+* Deques
+- One deque per worker, plus one for the threads outside the pool (main, loader, ...)
+- A new job goes to the back of the deque of the thread that creates it,
+  its owner takes jobs from the back (newest first, data still in its cache)
+- A thread without jobs steals from the front of the other deques
+  (oldest first: the biggest pieces of a split range)
+- Idle workers sleep until a job is pushed
+
+* Jobs
+- run(function, dependencies): the job is queued once every dependency has finished,
+  returns a handle for wait() / done() / further dependencies
+- wait(job): the waiting thread runs other jobs until its job is done (wait with help)
+  -> waiting never blocks a thread the pool could use, nested waits cannot deadlock
+- parallelFor(begin, end, grain, function): function(rangeBegin, rangeEnd) over pieces
+  of at most grain elements, the range is split in halves, one half pushed as a job,
+  the other split further -> thieves take big halves, few jobs per thread;
+  returns when the whole range is done, the caller works on it too
+- help(): runs one queued job, for a thread that waits on something else than a job
+
+* Stats
+- jobs executed, jobs stolen from another thread's deque
+*/
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+
+class JobSystem
+{
+public:
+    struct Job;
+    typedef std::shared_ptr<Job> JobHandle;
+
+    // stats
+    std::atomic<unsigned long long> Executed{0};
+    std::atomic<unsigned long long> Stolen{0};
+
+    // threads: including the waiting thread, 0 -> every hardware thread
+    // (workers + the deque of the threads outside the pool)
+    explicit JobSystem(unsigned int threads = 0)
+        : deques(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (unsigned int w = 0; w + 1 < deques.size(); w++)
+            workers.emplace_back(&JobSystem::work, this, w);
+    }
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        sleepCondition.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    // pool shared by every subsystem, created on first use
+    static JobSystem &shared()
+    {
+        static JobSystem jobs;
+        return jobs;
+    }
+
+    // workers + the waiting thread
+    unsigned int numThreads() const { return (unsigned int)workers.size() + 1; }
+
+    // queue function once every dependency is done
+    JobHandle run(std::function<void()> function, const std::vector<JobHandle> &dependencies = {})
+    {
+        JobHandle job = std::make_shared<Job>();
+        job->function = std::move(function);
+        for (const JobHandle &dependency : dependencies)
+        {
+            std::lock_guard<std::mutex> lock(dependency->mutex);
+            if (!dependency->completed)
+            {
+                dependency->dependents.push_back(job);
+                job->waitingFor.fetch_add(1);
+            }
+        }
+        // the count starts at 1 -> no dependency can queue the job before this point
+        if (job->waitingFor.fetch_sub(1) == 1)
+            push(job);
+        return job;
+    }
+
+    bool done(const JobHandle &job) const { return job->finished.load(std::memory_order_acquire); }
+
+    // run other jobs until job is done
+    void wait(const JobHandle &job)
+    {
+        while (!done(job))
+        {
+            if (!help())
+                std::this_thread::yield();
+        }
+    }
+
+    // function(rangeBegin, rangeEnd) over [begin, end) in pieces of at most grain elements
+    template <typename Function>
+    void parallelFor(size_t begin, size_t end, size_t grain, const Function &function)
+    {
+        if (end <= begin)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        if (workers.empty() || end - begin <= grain)
+        {
+            function(begin, end);
+            return;
+        }
+        std::atomic<size_t> remaining(end - begin);
+        // split: push the upper half, keep working on the lower one
+        std::function<void(size_t, size_t)> split = [&](size_t b, size_t e) {
+            while (e - b > grain)
+            {
+                const size_t middle = b + (e - b) / 2;
+                const size_t upper = e;
+                run([&split, middle, upper] { split(middle, upper); });
+                e = middle;
+            }
+            function(b, e);
+            remaining.fetch_sub(e - b, std::memory_order_release);
+        };
+        split(begin, end);
+        while (remaining.load(std::memory_order_acquire))
+        {
+            if (!help())
+                std::this_thread::yield();
+        }
+    }
+
+    // run one queued job (of any deque), false if there was none
+    // -> a thread that polls for something else can help meanwhile
+    bool help()
+    {
+        JobHandle job = find();
+        if (!job)
+            return false;
+        execute(job);
+        return true;
+    }
+
+    void printReport() const
+    {
+        std::cout << "Jobs: " << numThreads() << " threads, " << Executed.load() << " jobs, "
+                  << Stolen.load() << " stolen" << std::endl;
+    }
+
+    struct Job
+    {
+        std::function<void()> function;
+        // unfinished dependencies + 1 until run() returns
+        std::atomic<int> waitingFor{1};
+        std::atomic<bool> finished{false};
+        // guards completed + dependents
+        std::mutex mutex;
+        bool completed = false;
+        std::vector<JobHandle> dependents;
+    };
+
+private:
+    struct Deque
+    {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    // workers first, the last one is for threads outside the pool
+    std::vector<Deque> deques;
+    std::vector<std::thread> workers;
+    // jobs in all deques, workers sleep while there are none
+    std::atomic<int> queued{0};
+    std::atomic<int> sleeping{0};
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool stopping = false;
+
+    // deque of the calling thread: its own for a worker of this pool, else the shared one
+    struct ThreadSlot
+    {
+        const JobSystem *system = nullptr;
+        unsigned int index = 0;
+    };
+    static ThreadSlot &threadSlot()
+    {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+    unsigned int slot() const
+    {
+        const ThreadSlot &slot = threadSlot();
+        return slot.system == this ? slot.index : (unsigned int)deques.size() - 1;
+    }
+
+    void push(const JobHandle &job)
+    {
+        Deque &deque = deques[slot()];
+        {
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            deque.jobs.push_back(job);
+        }
+        queued.fetch_add(1);
+        // a worker about to sleep either sees queued > 0 or is waiting already
+        if (sleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            sleepCondition.notify_one();
+        }
+    }
+
+    // own deque from the back, then the others from the front
+    JobHandle find()
+    {
+        const unsigned int own = slot(), count = (unsigned int)deques.size();
+        for (unsigned int d = 0; d < count; d++)
+        {
+            const unsigned int index = (own + d) % count;
+            Deque &deque = deques[index];
+            std::lock_guard<std::mutex> lock(deque.mutex);
+            if (deque.jobs.empty())
+                continue;
+            JobHandle job;
+            if (d == 0)
+            {
+                job = std::move(deque.jobs.back());
+                deque.jobs.pop_back();
+            }
+            else
+            {
+                job = std::move(deque.jobs.front());
+                deque.jobs.pop_front();
+                Stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+            queued.fetch_sub(1);
+            return job;
+        }
+        return JobHandle();
+    }
+
+    void execute(const JobHandle &job)
+    {
+        job->function();
+        std::vector<JobHandle> dependents;
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->completed = true;
+            dependents.swap(job->dependents);
+        }
+        job->finished.store(true, std::memory_order_release);
+        Executed.fetch_add(1, std::memory_order_relaxed);
+        for (const JobHandle &dependent : dependents)
+        {
+            if (dependent->waitingFor.fetch_sub(1) == 1)
+                push(dependent);
+        }
+    }
+
+    void work(unsigned int index)
+    {
+        threadSlot().system = this;
+        threadSlot().index = index;
+        for (;;)
+        {
+            if (help())
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping.fetch_add(1);
+            sleepCondition.wait(lock, [this] { return stopping || queued.load() > 0; });
+            sleeping.fetch_sub(1);
+            if (stopping)
+                return;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,271 @@
+/*
+
+* Job system benchmark
+- Scaling of the work-stealing job system (see job_system.h) on pools of 1..N threads
+  (powers of two and N), against a naive baseline: one std::thread per task,
+  all started, then all joined
+- Workloads:
+    for     parallelFor over 2^22 elements, grain 1024 / 16384 / 262144 elements,
+            baseline: one thread per grain sized piece
+    tasks   4096 independent tasks of ~20 us + one job depending on all of them,
+            baseline: one thread per task
+    tree    sum over 2^22 elements as a binary tree of dependent jobs, 1024 leaves,
+            every inner node waits for its two children,
+            baseline: one thread per node, level by level (join before the next level)
+- Reported per workload and pool size: best time of the repetitions, speed-up over
+  the 1 thread pool, jobs stolen; the baseline as its own row
+- Every result is checked against a serial computation
+
+usage: job_system_bench [max threads] [repetitions] [workload]
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <cmath>
+#include <cstdlib>
+#include "job_system.h"
+
+// elements of the for / tree workloads
+static const size_t ELEMENTS = (size_t)1 << 22;
+static const size_t TASKS = 4096;
+static const size_t LEAVES = 1024;
+
+// per element work, a few flops
+static inline float kernel(float x)
+{
+    return std::sqrt(x) * std::sin(x * 0.001f);
+}
+
+// ~20 us of work
+static double task(size_t seed)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < 4000; i++)
+        sum += std::sqrt((double)(seed + i));
+    return sum;
+}
+
+static double bestOf(int repetitions, const std::function<void()> &setup, const std::function<void()> &run)
+{
+    double best = 1e30;
+    for (int r = 0; r < repetitions; r++)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        auto end = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(end - start).count() * 1000.0);
+    }
+    return best;
+}
+
+static void printRow(const std::string &workload, const std::string &threads, double ms, double baseMs, long long stolen)
+{
+    std::cout << std::left << std::setw(14) << workload << std::right << std::setw(10) << threads
+              << std::fixed << std::setprecision(2) << std::setw(11) << ms
+              << std::setw(9) << baseMs / ms << "x";
+    if (stolen >= 0)
+        std::cout << std::setw(10) << stolen;
+    std::cout << std::endl;
+}
+
+// one thread per function, all started, then all joined
+static void threadPerTask(const std::vector<std::function<void()>> &tasks)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(tasks.size());
+    for (const std::function<void()> &t : tasks)
+        threads.emplace_back(t);
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+int main(int argc, char *argv[])
+{
+    const unsigned int maxThreads = argc > 1 ? std::max(1, std::atoi(argv[1])) : std::max(1u, std::thread::hardware_concurrency());
+    const int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+    const std::string only = argc > 3 ? argv[3] : "";
+    const auto enabled = [&only](const char *workload) { return only.empty() || only == workload; };
+
+    std::vector<unsigned int> poolSizes;
+    for (unsigned int threads = 1; threads < maxThreads; threads *= 2)
+        poolSizes.push_back(threads);
+    poolSizes.push_back(maxThreads);
+
+    std::vector<float> input(ELEMENTS), output(ELEMENTS), reference(ELEMENTS);
+    for (size_t i = 0; i < ELEMENTS; i++)
+    {
+        input[i] = (float)(i % 10007);
+        reference[i] = kernel(input[i]);
+    }
+    const auto clearOutput = [&output] { std::fill(output.begin(), output.end(), 0.0f); };
+    const auto checkOutput = [&output, &reference](const std::string &what) {
+        if (output != reference)
+        {
+            std::cout << "ERROR::BENCH::RESULT_MISMATCH " << what << std::endl;
+            std::exit(-1);
+        }
+    };
+
+    std::cout << std::left << std::setw(14) << "workload" << std::right << std::setw(10) << "threads"
+              << std::setw(11) << "best ms" << std::setw(10) << "speedup" << std::setw(10) << "stolen" << std::endl;
+
+    if (enabled("for"))
+    {
+        for (size_t grain : {(size_t)1024, (size_t)16384, (size_t)262144})
+        {
+            const std::string name = "for " + std::to_string(grain);
+            double baseMs = 0.0;
+            for (unsigned int threads : poolSizes)
+            {
+                JobSystem jobs(threads);
+                const double ms = bestOf(repetitions, clearOutput, [&] {
+                    jobs.parallelFor(0, ELEMENTS, grain, [&](size_t begin, size_t end) {
+                        for (size_t i = begin; i < end; i++)
+                            output[i] = kernel(input[i]);
+                    });
+                });
+                checkOutput(name);
+                if (threads == 1)
+                    baseMs = ms;
+                printRow(name, std::to_string(threads), ms, baseMs, (long long)jobs.Stolen.load());
+            }
+            std::vector<std::function<void()>> pieces;
+            for (size_t begin = 0; begin < ELEMENTS; begin += grain)
+            {
+                const size_t end = std::min(ELEMENTS, begin + grain);
+                pieces.push_back([&, begin, end] {
+                    for (size_t i = begin; i < end; i++)
+                        output[i] = kernel(input[i]);
+                });
+            }
+            const double ms = bestOf(repetitions, clearOutput, [&] { threadPerTask(pieces); });
+            checkOutput(name + " baseline");
+            printRow(name, std::to_string(pieces.size()) + "*", ms, baseMs, -1);
+        }
+    }
+
+    if (enabled("tasks"))
+    {
+        double expected = 0.0;
+        for (size_t t = 0; t < TASKS; t++)
+            expected += task(t);
+        std::vector<double> results(TASKS);
+        const auto clearResults = [&results] { std::fill(results.begin(), results.end(), 0.0); };
+        const auto checkResults = [&](const std::string &what) {
+            double sum = 0.0;
+            for (double r : results)
+                sum += r;
+            if (sum != expected)
+            {
+                std::cout << "ERROR::BENCH::RESULT_MISMATCH " << what << std::endl;
+                std::exit(-1);
+            }
+        };
+        double baseMs = 0.0;
+        for (unsigned int threads : poolSizes)
+        {
+            JobSystem jobs(threads);
+            const double ms = bestOf(repetitions, clearResults, [&] {
+                std::vector<JobSystem::JobHandle> handles;
+                handles.reserve(TASKS);
+                for (size_t t = 0; t < TASKS; t++)
+                    handles.push_back(jobs.run([&results, t] { results[t] = task(t); }));
+                jobs.wait(jobs.run([] {}, handles));
+            });
+            checkResults("tasks");
+            if (threads == 1)
+                baseMs = ms;
+            printRow("tasks", std::to_string(threads), ms, baseMs, (long long)jobs.Stolen.load());
+        }
+        std::vector<std::function<void()>> tasks;
+        for (size_t t = 0; t < TASKS; t++)
+            tasks.push_back([&results, t] { results[t] = task(t); });
+        const double ms = bestOf(repetitions, clearResults, [&] { threadPerTask(tasks); });
+        checkResults("tasks baseline");
+        printRow("tasks", std::to_string(TASKS) + "*", ms, baseMs, -1);
+    }
+
+    if (enabled("tree"))
+    {
+        // nodes of a complete binary tree, leaves at [LEAVES - 1, 2 * LEAVES - 1)
+        std::vector<double> sums(2 * LEAVES - 1);
+        double expected = 0.0;
+        {
+            std::vector<double> leaves(LEAVES, 0.0);
+            for (size_t i = 0; i < ELEMENTS; i++)
+                leaves[i * LEAVES / ELEMENTS] += kernel(input[i]);
+            std::vector<double> level = leaves;
+            while (level.size() > 1)
+            {
+                std::vector<double> up(level.size() / 2);
+                for (size_t n = 0; n < up.size(); n++)
+                    up[n] = level[2 * n] + level[2 * n + 1];
+                level.swap(up);
+            }
+            expected = level[0];
+        }
+        const size_t perLeaf = ELEMENTS / LEAVES;
+        const auto node = [&](size_t n) {
+            if (n >= LEAVES - 1)
+            {
+                const size_t begin = (n - (LEAVES - 1)) * perLeaf;
+                double sum = 0.0;
+                for (size_t i = begin; i < begin + perLeaf; i++)
+                    sum += kernel(input[i]);
+                sums[n] = sum;
+            }
+            else
+                sums[n] = sums[2 * n + 1] + sums[2 * n + 2];
+        };
+        const auto clearSums = [&sums] { std::fill(sums.begin(), sums.end(), 0.0); };
+        const auto checkSums = [&](const std::string &what) {
+            if (sums[0] != expected)
+            {
+                std::cout << "ERROR::BENCH::RESULT_MISMATCH " << what << std::endl;
+                std::exit(-1);
+            }
+        };
+        double baseMs = 0.0;
+        for (unsigned int threads : poolSizes)
+        {
+            JobSystem jobs(threads);
+            const double ms = bestOf(repetitions, clearSums, [&] {
+                // leaves first, every inner node depends on its children
+                std::vector<JobSystem::JobHandle> handles(sums.size());
+                for (size_t n = sums.size(); n-- > 0;)
+                {
+                    if (n >= LEAVES - 1)
+                        handles[n] = jobs.run([&node, n] { node(n); });
+                    else
+                        handles[n] = jobs.run([&node, n] { node(n); }, {handles[2 * n + 1], handles[2 * n + 2]});
+                }
+                jobs.wait(handles[0]);
+            });
+            checkSums("tree");
+            if (threads == 1)
+                baseMs = ms;
+            printRow("tree", std::to_string(threads), ms, baseMs, (long long)jobs.Stolen.load());
+        }
+        const double ms = bestOf(repetitions, clearSums, [&] {
+            // one level after the other, a thread per node
+            for (size_t first = LEAVES - 1, count = LEAVES; count; count /= 2, first = (first - 1) / 2)
+            {
+                std::vector<std::function<void()>> level;
+                for (size_t n = first; n < first + count; n++)
+                    level.push_back([&node, n] { node(n); });
+                threadPerTask(level);
+            }
+        });
+        checkSums("tree baseline");
+        printRow("tree", std::to_string(sums.size()) + "*", ms, baseMs, -1);
+    }
+    std::cout << "* thread per task baseline: one thread per piece / task / node" << std::endl;
+    return 0;
+}
@@ -0,0 +1,302 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+* Frame profiler
+- CPU scopes: begin(name) / end() or a ProfileScope on the stack, nestable
+    - inside a frame: time added to the scope's total of the frame
+    - outside a frame (startup): every scope is kept and printed as a tree
+- GPU time: GL_TIME_ELAPSED query around the draw section (beginGpu / endGpu)
+    - queries cannot nest -> one per frame
+    - two queries used in turn, the result of a frame is read at the end of
+      the next frame -> no stall waiting for the GPU
+    - result still not available -> the frame has no GPU time (not waited for)
+- Frame stats in a ring buffer of the last FRAME_HISTORY frames:
+  CPU ms, GPU ms, draw calls, triangles, ms of every scope
+- printSummary(): p50 / p95 / p99 / max over the ring buffer, startup tree
+- openCSV(path): one row per frame, written when its GPU time is known (-1: unknown)
+
+* Compile time switch
+- -DPROFILER_DISABLED: every member is an empty inline function, nothing is measured
+*/
+
+#include <glad/glad.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <algorithm>
+
+#ifndef PROFILER_DISABLED
+
+class Profiler
+{
+public:
+    // frames kept for the percentiles
+    static const unsigned int FRAME_HISTORY = 1024;
+    // scopes measured inside frames, more are ignored
+    static const unsigned int MAX_SCOPES = 16;
+
+    Profiler() { history.resize(FRAME_HISTORY); }
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // CPU scopes
+    void begin(const char *name)
+    {
+        open.push_back({name, now()});
+    }
+    void end()
+    {
+        if (open.empty())
+            return;
+        const OpenScope scope = open.back();
+        open.pop_back();
+        const double ms = (now() - scope.start) * 1000.0;
+        if (!inFrame)
+        {
+            startup.push_back({scope.name, (unsigned int)open.size(), ms});
+            return;
+        }
+        const unsigned int id = scopeId(scope.name);
+        if (id < MAX_SCOPES)
+            current.scopeMs[id] += ms;
+    }
+
+    // frame boundaries, the stats of a frame are given at its end
+    void beginFrame()
+    {
+        inFrame = true;
+        current = FrameStats();
+        current.index = frames;
+        frameStart = now();
+    }
+    void endFrame(unsigned int drawCalls, unsigned long long triangles)
+    {
+        current.cpuMs = (now() - frameStart) * 1000.0;
+        current.drawCalls = drawCalls;
+        current.triangles = triangles;
+        inFrame = false;
+        // the previous frame's GPU time is due now, this frame waits for the next one
+        resolvePending(false);
+        pending = current;
+        hasPending = true;
+        frames++;
+    }
+
+    // GPU time of the draw section, once per frame
+    void beginGpu()
+    {
+        if (!queries[0])
+            glGenQueries(2, queries);
+        glBeginQuery(GL_TIME_ELAPSED, queries[frames % 2]);
+        current.hasQuery = true;
+    }
+    void endGpu()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+    }
+
+    // one row per frame from now on
+    bool openCSV(const std::string &path)
+    {
+        csv.open(path, std::ios::trunc);
+        if (!csv)
+        {
+            std::cout << "ERROR::PROFILER::CSV_NOT_OPENED " << path << std::endl;
+            return false;
+        }
+        csvScopes = 0;
+        csvHeader = false;
+        return true;
+    }
+
+    // startup tree and percentiles of the recorded frames
+    void printSummary()
+    {
+        // the last frame waits for its GPU time
+        resolvePending(true);
+        const std::ios::fmtflags flags = std::cout.flags();
+        const std::streamsize precision = std::cout.precision();
+        printFrames();
+        std::cout.flags(flags);
+        std::cout.precision(precision);
+    }
+
+private:
+    struct FrameStats
+    {
+        unsigned long long index = 0;
+        double cpuMs = 0.0;
+        double gpuMs = -1.0; // < 0 -> unknown
+        bool hasQuery = false;
+        unsigned int drawCalls = 0;
+        unsigned long long triangles = 0;
+        double scopeMs[MAX_SCOPES] = {};
+    };
+    struct OpenScope
+    {
+        const char *name;
+        double start;
+    };
+    struct StartupScope
+    {
+        const char *name;
+        unsigned int depth;
+        double ms;
+    };
+
+    std::vector<OpenScope> open;
+    std::vector<StartupScope> startup;
+    std::vector<std::string> scopeNames;
+    bool inFrame = false;
+    double frameStart = 0.0;
+    FrameStats current;
+    FrameStats pending;
+    bool hasPending = false;
+    unsigned long long frames = 0;
+    // ring buffer, frame n at n % FRAME_HISTORY
+    std::vector<FrameStats> history;
+    unsigned long long recorded = 0;
+    unsigned int queries[2] = {0, 0};
+    std::ofstream csv;
+    unsigned int csvScopes = 0;
+    bool csvHeader = false;
+
+    static double now()
+    {
+        static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    unsigned int scopeId(const char *name)
+    {
+        for (unsigned int id = 0; id < scopeNames.size(); id++)
+            if (scopeNames[id] == name)
+                return id;
+        scopeNames.push_back(name);
+        return (unsigned int)scopeNames.size() - 1;
+    }
+
+    // read the GPU time of the pending frame and store it
+    void resolvePending(bool wait)
+    {
+        if (!hasPending)
+            return;
+        hasPending = false;
+        if (pending.hasQuery)
+        {
+            const unsigned int query = queries[pending.index % 2];
+            GLint available = 0;
+            if (!wait)
+                glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (wait || available)
+            {
+                GLuint64 nanoseconds = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+                pending.gpuMs = nanoseconds / 1.0e6;
+            }
+        }
+        history[recorded % FRAME_HISTORY] = pending;
+        recorded++;
+        if (csv.is_open())
+        {
+            // header with the scopes of the first written frame
+            if (!csvHeader)
+            {
+                csv << "frame,cpu_ms,gpu_ms,draw_calls,triangles";
+                csvScopes = (unsigned int)std::min<size_t>(scopeNames.size(), MAX_SCOPES);
+                for (unsigned int id = 0; id < csvScopes; id++)
+                    csv << "," << scopeNames[id] << "_ms";
+                csv << "\n";
+                csvHeader = true;
+            }
+            csv << pending.index << "," << pending.cpuMs << "," << pending.gpuMs << ","
+                << pending.drawCalls << "," << pending.triangles;
+            // scopes first seen after the header was written are left out
+            for (unsigned int id = 0; id < csvScopes; id++)
+                csv << "," << pending.scopeMs[id];
+            csv << "\n";
+        }
+    }
+
+    // startup tree, percentiles table
+    void printFrames()
+    {
+        if (!startup.empty())
+        {
+            std::cout << "Startup:" << std::endl;
+            for (const StartupScope &scope : startup)
+                std::cout << "  " << std::string(scope.depth * 2, ' ') << std::left << std::setw(32 - scope.depth * 2)
+                          << scope.name << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+                          << scope.ms << " ms" << std::endl;
+        }
+        const unsigned int count = (unsigned int)std::min<unsigned long long>(recorded, FRAME_HISTORY);
+        if (!count)
+            return;
+        std::cout << "Frames: last " << count << " of " << recorded << std::endl;
+        std::cout << "  " << std::left << std::setw(20) << "" << std::right << std::setw(10) << "p50"
+                  << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+        std::vector<double> values;
+        printRow("cpu ms", 2, values, count, [](const FrameStats &f) { return f.cpuMs; });
+        printRow("gpu ms", 2, values, count, [](const FrameStats &f) { return f.gpuMs; });
+        printRow("draw calls", 0, values, count, [](const FrameStats &f) { return (double)f.drawCalls; });
+        printRow("triangles", 0, values, count, [](const FrameStats &f) { return (double)f.triangles; });
+        for (unsigned int id = 0; id < scopeNames.size() && id < MAX_SCOPES; id++)
+            printRow(scopeNames[id] + " ms", 2, values, count, [id](const FrameStats &f) { return f.scopeMs[id]; });
+    }
+
+    template <typename Value>
+    void printRow(const std::string &name, int decimals, std::vector<double> &values, unsigned int count, Value value) const
+    {
+        values.clear();
+        for (unsigned int f = 0; f < count; f++)
+        {
+            double v = value(history[f]);
+            if (v >= 0.0)
+                values.push_back(v);
+        }
+        if (values.empty())
+            return;
+        std::sort(values.begin(), values.end());
+        const auto percentile = [&values](double p) { return values[(size_t)(p * (values.size() - 1) + 0.5)]; };
+        std::cout << "  " << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(decimals)
+                  << std::setw(10) << percentile(0.50) << std::setw(10) << percentile(0.95)
+                  << std::setw(10) << percentile(0.99) << std::setw(10) << values.back() << std::endl;
+    }
+};
+
+#else
+
+// profiling compiled out, same interface
+class Profiler
+{
+public:
+    void begin(const char *) {}
+    void end() {}
+    void beginFrame() {}
+    void endFrame(unsigned int, unsigned long long) {}
+    void beginGpu() {}
+    void endGpu() {}
+    bool openCSV(const std::string &) { return false; }
+    void printSummary() {}
+};
+
+#endif
+
+// CPU scope until the end of the block
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler &profiler, const char *name) : profiler(profiler) { profiler.begin(name); }
+    ~ProfileScope() { profiler.end(); }
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    Profiler &profiler;
+};
+
+#endif
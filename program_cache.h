@@ -0,0 +1,201 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+/*
+* Program binary cache
+- Compiling + linking the GLSL of every program on every launch is part of the startup time
+- First launch: the linked program is read back (glGetProgramBinary) and written
+  to "<directory>/<key>.bin"
+- Later launches: glProgramBinary from that file, no compile / link at all
+- key: FNV-1a 64 over the sources of every stage + GL_VENDOR, GL_RENDERER, GL_VERSION
+  -> an edited shader or another driver gets another file, old files are simply not used
+
+* .bin file
+- magic "GLPB", version, binary format, binary length, then the driver's binary
+
+* Stale binary
+- The driver may still reject a binary with a matching key (driver update with the same
+  version string, ...): glProgramBinary fails -> compiled from source, file rewritten
+
+* Functions
+- ARB_get_program_binary (core in 4.1) is not part of the 3.3 GLAD loader ->
+  enable() loads glGetProgramBinary / glProgramBinary / glProgramParameteri itself,
+  with the same loader GLAD was given
+- Not enabled, functions missing or no binary format -> every program is compiled from source
+*/
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <sys/stat.h>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+class ProgramCache
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    // programs loaded from / written to the cache since enable()
+    static unsigned int Hits;
+    static unsigned int Misses;
+
+    // load the binary functions through loader, cache files in directory (created if missing)
+    static bool enable(GLADloadproc loader, const std::string &directory)
+    {
+        State &state = get();
+        state.getProgramBinary = (GetProgramBinaryProc)loader("glGetProgramBinary");
+        state.programBinary = (ProgramBinaryProc)loader("glProgramBinary");
+        state.programParameteri = (ProgramParameteriProc)loader("glProgramParameteri");
+        GLint formats = 0;
+        if (state.getProgramBinary && state.programBinary && state.programParameteri)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        // GL_NUM_PROGRAM_BINARY_FORMATS unknown before 4.1 -> error flag set, cleared here
+        while (glGetError() != GL_NO_ERROR)
+            ;
+        if (formats <= 0)
+        {
+            std::cout << "Program cache: not supported by the driver, shaders compiled from source" << std::endl;
+            state.enabled = false;
+            return false;
+        }
+        mkdir(directory.c_str(), 0755);
+        state.directory = directory;
+        state.driver = std::string((const char *)glGetString(GL_VENDOR)) + "\n"
+                     + (const char *)glGetString(GL_RENDERER) + "\n" + (const char *)glGetString(GL_VERSION);
+        state.enabled = true;
+        return true;
+    }
+
+    static bool enabled() { return get().enabled; }
+
+    // hex key of the program built from sources on this driver
+    static std::string key(const std::vector<std::string> &sources)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        const auto add = [&hash](const std::string &text) {
+            // length first -> ("ab", "c") and ("a", "bc") differ
+            const uint64_t length = text.size();
+            for (int b = 0; b < 8; b++)
+                hash = (hash ^ ((length >> (b * 8)) & 0xff)) * 1099511628211ull;
+            for (unsigned char c : text)
+                hash = (hash ^ c) * 1099511628211ull;
+        };
+        for (const std::string &source : sources)
+            add(source);
+        add(get().driver);
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+        return hex;
+    }
+
+    // before glLinkProgram: allow reading the binary back afterwards
+    static void prepare(unsigned int program)
+    {
+        if (enabled())
+            get().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // program linked from the cached binary of key, false -> compile it
+    static bool load(unsigned int program, const std::string &key)
+    {
+        if (!enabled())
+            return false;
+        std::ifstream stream(path(key), std::ios::binary);
+        uint32_t header[4] = {0, 0, 0, 0};
+        if (!stream.read((char *)header, sizeof(header)) || header[0] != MAGIC || header[1] != VERSION)
+        {
+            Misses++;
+            return false;
+        }
+        std::vector<char> binary(header[3]);
+        if (!stream.read(binary.data(), binary.size()))
+        {
+            Misses++;
+            return false;
+        }
+        get().programBinary(program, header[2], binary.data(), (GLsizei)binary.size());
+        GLint success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            Misses++;
+            return false;
+        }
+        Hits++;
+        return true;
+    }
+
+    // after a successful link: write the program's binary for key
+    static bool save(unsigned int program, const std::string &key)
+    {
+        if (!enabled())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        get().getProgramBinary(program, length, &length, &format, binary.data());
+        // written under a temporary name -> an interrupted write never leaves a broken file
+        const std::string file = path(key), temporary = file + ".tmp";
+        {
+            std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+            const uint32_t header[4] = {MAGIC, VERSION, (uint32_t)format, (uint32_t)length};
+            stream.write((const char *)header, sizeof(header));
+            stream.write(binary.data(), length);
+            if (!stream)
+            {
+                std::cout << "ERROR::PROGRAM_CACHE::FILE_NOT_WRITTEN " << file << std::endl;
+                return false;
+            }
+        }
+        return std::rename(temporary.c_str(), file.c_str()) == 0;
+    }
+
+private:
+    static const uint32_t MAGIC = 0x42504c47; // "GLPB"
+
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint, GLsizei, GLsizei *, GLenum *, void *);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint, GLenum, const void *, GLsizei);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint, GLenum, GLint);
+
+    struct State
+    {
+        bool enabled = false;
+        std::string directory;
+        std::string driver;
+        GetProgramBinaryProc getProgramBinary = NULL;
+        ProgramBinaryProc programBinary = NULL;
+        ProgramParameteriProc programParameteri = NULL;
+    };
+
+    static State &get()
+    {
+        static State state;
+        return state;
+    }
+
+    static std::string path(const std::string &key)
+    {
+        return get().directory + "/" + key + ".bin";
+    }
+};
+
+unsigned int ProgramCache::Hits = 0;
+unsigned int ProgramCache::Misses = 0;
+
+#endif
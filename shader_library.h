@@ -0,0 +1,137 @@
+#ifndef SHADER_LIBRARY_H
+#define SHADER_LIBRARY_H
+
+/*
+* Shader library
+- Every program is submitted up front (add), right after the context is created
+  -> the driver compiles while the CPU loads the height map and builds the mesh
+- get(id): first use of a program, only then waits for it (Shader::finish)
+- Permutations: add() with a list of defines (see the preprocessor in shaders.h),
+  the same files + defines again give the id of the first add, nothing is built twice
+- poll(): finishes the programs the driver is done with, never blocks
+  (call it between the startup steps)
+
+* Parallel compile
+- KHR_parallel_shader_compile (or the ARB version): glMaxShaderCompilerThreadsKHR(0xFFFFFFFF)
+  lets the driver use as many compiler threads as it wants,
+  GL_COMPLETION_STATUS_KHR tells when a program is done without waiting
+- Without the extension: drivers with their own compile threads still overlap
+  (the status is not read before get()), poll() does nothing
+- Not in the 3.3 GLAD loader -> the function is loaded through the context's loader
+
+* Report
+- programs ready before their first use, time get() spent waiting
+*/
+
+#include <glad/glad.h>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include "shaders.h"
+
+class ShaderLibrary
+{
+public:
+    // driver compiles on its own threads, completion can be polled
+    bool ParallelCompile = false;
+    // time spent blocked in get()
+    double WaitMs = 0.0;
+
+    explicit ShaderLibrary(GLADloadproc loader)
+    {
+        typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint);
+        MaxShaderCompilerThreadsProc maxThreads = NULL;
+        if (hasGLExtension("GL_KHR_parallel_shader_compile"))
+            maxThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+        else if (hasGLExtension("GL_ARB_parallel_shader_compile"))
+            maxThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+        if (maxThreads)
+        {
+            // implementation chosen number of threads
+            maxThreads(0xFFFFFFFF);
+            ParallelCompile = true;
+        }
+    }
+    ShaderLibrary(const ShaderLibrary &) = delete;
+    ShaderLibrary &operator=(const ShaderLibrary &) = delete;
+
+    // start building the permutation of a program, id for get()
+    unsigned int add(const char *vertexPath, const char *fragmentPath, const std::vector<std::string> &defines = {})
+    {
+        // key: files + sorted defines
+        std::vector<std::string> sorted = defines;
+        std::sort(sorted.begin(), sorted.end());
+        std::string key = std::string(vertexPath) + "|" + fragmentPath;
+        for (const std::string &define : sorted)
+            key += "|" + define;
+        std::map<std::string, unsigned int>::const_iterator found = ids.find(key);
+        if (found != ids.end())
+            return found->second;
+
+        programs.push_back(std::unique_ptr<Shader>(new Shader()));
+        programs.back()->submit(vertexPath, fragmentPath, defines);
+        readyBeforeUse.push_back(!programs.back()->pending());
+        const unsigned int id = (unsigned int)programs.size() - 1;
+        ids[key] = id;
+        return id;
+    }
+
+    // finish the programs that are done, number still compiling
+    unsigned int poll()
+    {
+        unsigned int compiling = 0;
+        for (size_t id = 0; id < programs.size(); id++)
+        {
+            Shader &shader = *programs[id];
+            if (!shader.pending())
+                continue;
+            if (ParallelCompile && shader.completed())
+            {
+                shader.finish();
+                readyBeforeUse[id] = true;
+            }
+            else
+                compiling++;
+        }
+        return compiling;
+    }
+
+    // program id, built -> waits for it on first use
+    Shader &get(unsigned int id)
+    {
+        Shader &shader = *programs[id];
+        if (shader.pending())
+        {
+            const auto start = std::chrono::steady_clock::now();
+            shader.finish();
+            WaitMs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+        }
+        return shader;
+    }
+
+    unsigned int size() const { return (unsigned int)programs.size(); }
+
+    void printReport() const
+    {
+        unsigned int ready = 0;
+        for (bool r : readyBeforeUse)
+            ready += r;
+        std::cout << "Shaders: " << programs.size() << " programs, parallel compile "
+                  << (ParallelCompile ? "on" : "off") << ", " << ready << " ready before first use, waited "
+                  << WaitMs << " ms" << std::endl;
+    }
+
+private:
+    // stable addresses, get() hands out references
+    std::vector<std::unique_ptr<Shader>> programs;
+    std::vector<bool> readyBeforeUse;
+    // permutation key -> id
+    std::map<std::string, unsigned int> ids;
+};
+
+#endif
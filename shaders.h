@@ -9,6 +9,73 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "program_cache.h"
+
+// * Uniforms
+// - all active uniforms are read once after linking into a flat table (name, location, type, last value)
+// - Uniform<T>: typed handle = index into that table, looked up once by name, no string per frame
+// - setters skip the glUniform call when the value did not change
+//   (the table only knows values set through this class)
+// - like glUniform*, setters apply to the program in use -> call use() first
+// - uniform blocks named in UNIFORM_BLOCK_NAMES are bound to their fixed binding point at link time
+//   -> a buffer bound once to that point feeds every program declaring the block
+
+// * Two-phase build
+// - submit(): reads the sources, starts compile + link, does not ask for any result
+//   -> a driver compiling on its own threads keeps working while the caller does other things
+// - finish(): waits for the result, prints the errors, fills the uniform table
+// - completed(): GL_COMPLETION_STATUS_KHR, never blocks (only with KHR_parallel_shader_compile,
+//   see shader_library.h)
+// - the constructor with paths does both at once
+
+// * Preprocessor
+// - #include "file": replaced by the file, path relative to the including file,
+//   every file included once per stage
+// - defines ("NAME" or "NAME value") are inserted as #define lines right after #version
+//   -> one source, specialized permutations: #ifdef'd code is compiled out instead of
+//      branching on a uniform for every vertex / fragment
+// - #line directives keep the line numbers of every file, the source string number in
+//   compiler messages is the file's index (listed with the error)
+
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// extension of the current context, for the functions loaded outside GLAD
+// (see shader_library.h, stream_buffer.h)
+inline bool hasGLExtension(const char *name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        if (!std::strcmp((const char *)glGetStringi(GL_EXTENSIONS, i), name))
+            return true;
+    }
+    return false;
+}
+
+// Defines the shared uniform blocks, the value is the binding point
+enum Uniform_Block {
+    FRAME_BLOCK,    // per-frame camera data (see frame_uniforms.h)
+    NUM_UNIFORM_BLOCKS
+};
+
+const char *const UNIFORM_BLOCK_NAMES[NUM_UNIFORM_BLOCKS] = {
+    "FrameUniforms"
+};
+
+// string-free handle of an active uniform, T: bool, int, float, glm::vec2, glm::vec3, glm::mat4
+// not active / wrong type -> invalid handle, setting it does nothing
+template <typename T>
+struct Uniform
+{
+    int index = -1;
+    bool valid() const { return index >= 0; }
+};
 
 class Shader
 {
@@ -17,88 +84,171 @@ public:
     unsigned int ID;
 
     // constructor reads and builds the shader
-    Shader(const char* vertexPath, const char* fragmentPath);
+    Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines = {});
+    // empty, built later with submit() + finish()
+    Shader() : ID(0) {}
+    // start building, results not checked yet
+    void submit(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines = {});
+    // compile + link done, does not wait
+    bool completed() const;
+    // wait until built, false if it failed
+    bool finish();
+    // submitted and not finished yet
+    bool pending() const { return vertex != 0; }
     // use/activate the shader
     void use();
-    // utility uniform functions
-    void setBool(const std::string &name, bool value) const;
-    void setInt(const std::string &name, int value) const;
-    void setFloat(const std::string &name, float value) const;
-    void setMat4(const std::string &name, glm::mat4 &value) const;
-};
+    // handle of the uniform "name", checked against the type of the uniform
+    template <typename T>
+    Uniform<T> uniform(const char *name) const;
+    // typed, cached uniform setters
+    void set(Uniform<bool> uniform, bool value) const;
+    void set(Uniform<int> uniform, int value) const;
+    void set(Uniform<float> uniform, float value) const;
+    void set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const;
+    void set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const;
+    void set(Uniform<glm::mat4> uniform, const glm::mat4 &value) const;
+    // utility uniform functions, by name (table lookup, cached like the handles)
+    void setBool(const char *name, bool value) const;
+    void setInt(const char *name, int value) const;
+    void setFloat(const char *name, float value) const;
+    void setVec2(const char *name, const glm::vec2 &value) const;
+    void setVec3(const char *name, const glm::vec3 &value) const;
+    void setMat4(const char *name, const glm::mat4 &value) const;
+    void setBool(const std::string &name, bool value) const { setBool(name.c_str(), value); }
+    void setInt(const std::string &name, int value) const { setInt(name.c_str(), value); }
+    void setFloat(const std::string &name, float value) const { setFloat(name.c_str(), value); }
+    void setVec2(const std::string &name, const glm::vec2 &value) const { setVec2(name.c_str(), value); }
+    void setVec3(const std::string &name, const glm::vec3 &value) const { setVec3(name.c_str(), value); }
+    void setMat4(const std::string &name, const glm::mat4 &value) const { setMat4(name.c_str(), value); }
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
-{
-    // * 1. Retrieve the vertex/fragment source code from filePath
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
+    // source of path with the defines and every #include, files: path of every source string number
+    static bool preprocess(const std::string &path, const std::vector<std::string> &defines,
+                           std::string &code, std::vector<std::string> &files);
 
-    // ensure ifstream objects can throw exceptions
-    vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-    try
+private:
+    struct UniformInfo
     {
-        // open files
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-
-        // read file's buffer contents into streams
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-
-        // close file handlers
-        vShaderFile.close();
-        fShaderFile.close();
-
-        // convert stream into string
-        vertexCode  = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch(std::ifstream::failure e)
+        std::string name;  // without "[0]" for arrays
+        int location;
+        GLenum type;
+        bool known;        // value holds what the program has
+        float value[16];   // last value, raw bytes of the largest type (mat4)
+    };
+    mutable std::vector<UniformInfo> uniforms;
+    // shaders of a submitted program, 0 once finished or loaded from the cache
+    unsigned int vertex = 0;
+    unsigned int fragment = 0;
+    std::string cacheKey;
+    bool linked = false;
+    // files of every stage, for the error messages
+    std::vector<std::string> vertexFiles;
+    std::vector<std::string> fragmentFiles;
+
+    // read the active uniforms of the linked program
+    void reflectUniforms();
+    // bind the shared uniform blocks the program declares
+    void bindUniformBlocks();
+    // text of file + its includes appended to code
+    static bool expand(const std::string &text, int file, int firstLine, std::string &code, std::vector<std::string> &files);
+    static bool readFile(const std::string &path, std::string &text);
+    static void printFiles(const std::vector<std::string> &files);
+    // table index of name, -1 if not an active uniform
+    int find(const char *name) const;
+    // remember value, true if it differs from the last one (-> upload)
+    bool changed(int index, const void *value, size_t bytes) const;
+    // GL types a handle of T may point to
+    static bool typeMatches(GLenum type, bool *) { return type == GL_BOOL || type == GL_INT; }
+    static bool typeMatches(GLenum type, int *)
     {
-        std::cout << "ERROR::SHADER::FILE_NOt_SUCCESSFULLY_READ" << std::endl;
+        return type == GL_INT || type == GL_BOOL || type == GL_SAMPLER_2D || type == GL_SAMPLER_3D
+            || type == GL_SAMPLER_CUBE || type == GL_SAMPLER_2D_ARRAY || type == GL_SAMPLER_BUFFER;
     }
+    static bool typeMatches(GLenum type, float *) { return type == GL_FLOAT; }
+    static bool typeMatches(GLenum type, glm::vec2 *) { return type == GL_FLOAT_VEC2; }
+    static bool typeMatches(GLenum type, glm::vec3 *) { return type == GL_FLOAT_VEC3; }
+    static bool typeMatches(GLenum type, glm::mat4 *) { return type == GL_FLOAT_MAT4; }
+};
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines)
+{
+    submit(vertexPath, fragmentPath, defines);
+    finish();
+}
+
+void Shader::submit(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines)
+{
+    // * 1. Retrieve the vertex/fragment source code from filePath, includes and defines resolved
+    std::string vertexCode;
+    std::string fragmentCode;
+    // read errors are printed here, the empty source then fails to compile
+    preprocess(vertexPath, defines, vertexCode, vertexFiles);
+    preprocess(fragmentPath, defines, fragmentCode, fragmentFiles);
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
-    
 
-    // * 2. Compile shaders
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
+    // linked before with the same sources and driver -> binary from the cache (see program_cache.h)
+    ID = glCreateProgram();
+    uniforms.clear();
+    linked = false;
+    cacheKey = ProgramCache::enabled() ? ProgramCache::key({vertexCode, fragmentCode}) : "";
+    if (ProgramCache::load(ID, cacheKey))
+    {
+        linked = true;
+        reflectUniforms();
+        bindUniformBlocks();
+        return;
+    }
 
+    // * 2. Compile shaders, the status is read in finish()
     // vertex shader
     vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, NULL);
     glCompileShader(vertex);
+
+    // fragment shader
+    fragment = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment, 1, &fShaderCode, NULL);
+    glCompileShader(fragment);
+
+    // shader program
+    glAttachShader(ID, vertex);
+    glAttachShader(ID, fragment);
+    ProgramCache::prepare(ID);
+    glLinkProgram(ID);
+}
+
+bool Shader::completed() const
+{
+    if (!pending())
+        return true;
+    int done = 0;
+    glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+    return done != 0;
+}
+
+bool Shader::finish()
+{
+    if (!pending())
+        return linked;
+    int success;
+    char infoLog[512];
+
     // print compile errors if any
     glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
     if(!success)
     {
         glGetShaderInfoLog(vertex, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        printFiles(vertexFiles);
     }
-
-    // fragment shader
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
-    // print compile errors if any
     glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
     if(!success)
     {
         glGetShaderInfoLog(fragment, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        printFiles(fragmentFiles);
     }
 
-    // shader program
-    ID = glCreateProgram();
-    glAttachShader(ID, vertex);
-    glAttachShader(ID, fragment);
-    glLinkProgram(ID);
     // pring linking errors if any
     glGetProgramiv(ID, GL_LINK_STATUS, &success);
     if(!success)
@@ -106,10 +256,189 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
         glGetProgramInfoLog(ID, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
     }
+    else
+    {
+        linked = true;
+        ProgramCache::save(ID, cacheKey);
+    }
 
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    vertex = 0;
+    fragment = 0;
+
+    reflectUniforms();
+    bindUniformBlocks();
+    return linked;
+}
+
+bool Shader::readFile(const std::string &path, std::string &text)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::stringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return true;
+}
+
+bool Shader::preprocess(const std::string &path, const std::vector<std::string> &defines,
+                        std::string &code, std::vector<std::string> &files)
+{
+    code.clear();
+    files.clear();
+    std::string text;
+    if (!readFile(path, text))
+    {
+        std::cout << "ERROR::SHADER::FILE_NOt_SUCCESSFULLY_READ " << path << std::endl;
+        return false;
+    }
+    files.push_back(path);
+    // #version must stay the first line, the defines follow it
+    size_t body = 0;
+    if (text.compare(0, 8, "#version") == 0)
+    {
+        body = text.find('\n');
+        body = body == std::string::npos ? text.size() : body + 1;
+        code.append(text, 0, body);
+    }
+    for (const std::string &define : defines)
+        code += "#define " + define + "\n";
+    const int firstLine = body ? 2 : 1;
+    code += "#line " + std::to_string(firstLine) + " 0\n";
+    return expand(text.substr(body), 0, firstLine, code, files);
+}
+
+bool Shader::expand(const std::string &text, int file, int firstLine, std::string &code, std::vector<std::string> &files)
+{
+    std::istringstream lines(text);
+    std::string line;
+    int number = firstLine - 1;
+    while (std::getline(lines, line))
+    {
+        number++;
+        const size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+        {
+            code += line;
+            code += '\n';
+            continue;
+        }
+        const size_t open = line.find('"', start);
+        const size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            std::cout << "ERROR::SHADER::INVALID_INCLUDE " << files[file] << ":" << number << std::endl;
+            return false;
+        }
+        // relative to the including file
+        const size_t slash = files[file].find_last_of('/');
+        const std::string path = (slash == std::string::npos ? "" : files[file].substr(0, slash + 1))
+                               + line.substr(open + 1, close - open - 1);
+        // included before -> nothing, keeps the line count
+        if (std::find(files.begin(), files.end(), path) != files.end())
+        {
+            code += '\n';
+            continue;
+        }
+        std::string included;
+        if (!readFile(path, included))
+        {
+            std::cout << "ERROR::SHADER::INCLUDE_NOT_READ " << path << " (" << files[file] << ":" << number << ")" << std::endl;
+            return false;
+        }
+        files.push_back(path);
+        const int index = (int)files.size() - 1;
+        code += "#line 1 " + std::to_string(index) + "\n";
+        if (!expand(included, index, 1, code, files))
+            return false;
+        code += "#line " + std::to_string(number + 1) + " " + std::to_string(file) + "\n";
+    }
+    return true;
+}
+
+void Shader::printFiles(const std::vector<std::string> &files)
+{
+    if (files.size() < 2)
+        return;
+    std::cout << "source strings:";
+    for (size_t f = 0; f < files.size(); f++)
+        std::cout << " " << f << " " << files[f];
+    std::cout << std::endl;
+}
+
+void Shader::reflectUniforms()
+{
+    uniforms.clear();
+    int count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength + 1);
+    for (int i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        UniformInfo info;
+        info.name.assign(name.data(), length);
+        // arrays are reported as "name[0]"
+        if (info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0)
+            info.name.resize(info.name.size() - 3);
+        info.location = glGetUniformLocation(ID, name.data());
+        // members of uniform blocks have no location
+        if (info.location < 0)
+            continue;
+        info.type = type;
+        info.known = false;
+        uniforms.push_back(info);
+    }
+}
+
+void Shader::bindUniformBlocks()
+{
+    for (unsigned int block = 0; block < NUM_UNIFORM_BLOCKS; block++)
+    {
+        GLuint index = glGetUniformBlockIndex(ID, UNIFORM_BLOCK_NAMES[block]);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, block);
+    }
+}
+
+int Shader::find(const char *name) const
+{
+    for (size_t i = 0; i < uniforms.size(); i++)
+    {
+        if (uniforms[i].name == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+bool Shader::changed(int index, const void *value, size_t bytes) const
+{
+    UniformInfo &info = uniforms[index];
+    if (info.known && std::memcmp(info.value, value, bytes) == 0)
+        return false;
+    std::memcpy(info.value, value, bytes);
+    info.known = true;
+    return true;
+}
+
+template <typename T>
+Uniform<T> Shader::uniform(const char *name) const
+{
+    Uniform<T> handle;
+    int index = find(name);
+    if (index >= 0 && !typeMatches(uniforms[index].type, (T *)nullptr))
+    {
+        std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << name << std::endl;
+        index = -1;
+    }
+    handle.index = index;
+    return handle;
 }
 
 void Shader::use()
@@ -117,21 +446,59 @@ void Shader::use()
     glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string &name, bool value) const
+void Shader::set(Uniform<bool> uniform, bool value) const
+{
+    set(Uniform<int>{uniform.index}, (int)value);
+}
+void Shader::set(Uniform<int> uniform, int value) const
+{
+    if (uniform.index >= 0 && changed(uniform.index, &value, sizeof(value)))
+        glUniform1i(uniforms[uniform.index].location, value);
+}
+void Shader::set(Uniform<float> uniform, float value) const
+{
+    if (uniform.index >= 0 && changed(uniform.index, &value, sizeof(value)))
+        glUniform1f(uniforms[uniform.index].location, value);
+}
+void Shader::set(Uniform<glm::vec2> uniform, const glm::vec2 &value) const
+{
+    if (uniform.index >= 0 && changed(uniform.index, &value[0], sizeof(float) * 2))
+        glUniform2fv(uniforms[uniform.index].location, 1, &value[0]);
+}
+void Shader::set(Uniform<glm::vec3> uniform, const glm::vec3 &value) const
+{
+    if (uniform.index >= 0 && changed(uniform.index, &value[0], sizeof(float) * 3))
+        glUniform3fv(uniforms[uniform.index].location, 1, &value[0]);
+}
+void Shader::set(Uniform<glm::mat4> uniform, const glm::mat4 &mat) const
+{
+    if (uniform.index >= 0 && changed(uniform.index, &mat[0][0], sizeof(float) * 16))
+        glUniformMatrix4fv(uniforms[uniform.index].location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::setBool(const char *name, bool value) const
+{
+    set(Uniform<int>{find(name)}, (int)value);
+}
+void Shader::setInt(const char *name, int value) const
+{
+    set(Uniform<int>{find(name)}, value);
+}
+void Shader::setFloat(const char *name, float value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    set(Uniform<float>{find(name)}, value);
 }
-void Shader::setInt(const std::string &name, int value) const
+void Shader::setVec2(const char *name, const glm::vec2 &value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    set(Uniform<glm::vec2>{find(name)}, value);
 }
-void Shader::setFloat(const std::string &name, float value) const
+void Shader::setVec3(const char *name, const glm::vec3 &value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    set(Uniform<glm::vec3>{find(name)}, value);
 }
-void Shader::setMat4(const std::string &name, glm::mat4 &mat) const
+void Shader::setMat4(const char *name, const glm::mat4 &mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    set(Uniform<glm::mat4>{find(name)}, mat);
 }
 
 #endif
\ No newline at end of file
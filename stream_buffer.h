@@ -0,0 +1,183 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+/*
+* Streaming ring buffer
+- One buffer object for every piece of data that changes each frame
+  (instance attributes, the per-frame uniform block, ...), cut into FRAMES regions
+- Frame n writes only into region n % FRAMES, subsystems suballocate from it with
+  write(data, bytes, alignment) and bind the buffer at the returned offset
+  -> no glBufferData per subsystem and frame, no new storage every frame
+
+* Persistent mapping (ARB_buffer_storage, core in 4.4)
+- Immutable storage mapped once, PERSISTENT | COHERENT -> write() is a memcpy
+- A fence after the frame's last use of its region, waited for before the region is
+  written FRAMES frames later; a fence not yet signaled is a stall (counted, timed)
+- glBufferStorage is not in the 3.3 GLAD loader -> loaded through the context's loader
+
+* Fallback (plain GL 3.3)
+- The buffer is orphaned (glBufferData NULL) whenever the ring wraps to region 0 ->
+  the driver hands out fresh storage while the GPU still reads the old one,
+  write() is a glBufferSubData into the region -> stalls are up to the driver, not counted
+
+* Stats
+- bytes written during the last frame, peak, total, stalls and time stalled,
+  writes that did not fit into the region (dropped, reported once)
+*/
+
+#include <glad/glad.h>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include "shaders.h"
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+class StreamBuffer
+{
+public:
+    // regions in flight: the CPU writes one while the GPU may still read the two before
+    static const unsigned int FRAMES = 3;
+
+    // persistent mapping in use (else orphaning)
+    bool Persistent = false;
+    // offset alignment for uniform blocks (GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT)
+    size_t UniformAlignment = 256;
+    // stats
+    size_t FrameBytes = 0;
+    size_t PeakFrameBytes = 0;
+    unsigned long long TotalBytes = 0;
+    unsigned long long Frames = 0;
+    unsigned long long Stalls = 0;
+    double StallMs = 0.0;
+    unsigned long long Overflows = 0;
+
+    // frameBytes: size of one region
+    StreamBuffer(GLADloadproc loader, size_t frameBytes) : regionBytes(frameBytes)
+    {
+        GLint alignment = 0;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment > 0)
+            UniformAlignment = (size_t)alignment;
+
+        glGenBuffers(1, &bufferId);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+        typedef void (APIENTRYP BufferStorageProc)(GLenum, GLsizeiptr, const void *, GLbitfield);
+        BufferStorageProc bufferStorage = NULL;
+        if (hasGLExtension("GL_ARB_buffer_storage"))
+            bufferStorage = (BufferStorageProc)loader("glBufferStorage");
+        if (bufferStorage)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_COPY_WRITE_BUFFER, regionBytes * FRAMES, NULL, flags);
+            mapped = (unsigned char *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionBytes * FRAMES, flags);
+            Persistent = mapped != NULL;
+        }
+        if (!Persistent)
+        {
+            // storage of a failed buffer storage attempt is immutable -> new buffer
+            if (bufferStorage)
+            {
+                glDeleteBuffers(1, &bufferId);
+                glGenBuffers(1, &bufferId);
+                glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+            }
+            glBufferData(GL_COPY_WRITE_BUFFER, regionBytes * FRAMES, NULL, GL_STREAM_DRAW);
+        }
+    }
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    GLuint buffer() const { return bufferId; }
+
+    // region of this frame, waits until the GPU is done with it
+    void beginFrame()
+    {
+        region = Frames % FRAMES;
+        offset = 0;
+        FrameBytes = 0;
+        if (Persistent && fences[region])
+        {
+            if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                    ;
+                StallMs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1000.0;
+                Stalls++;
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+        else if (!Persistent && region == 0)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+            glBufferData(GL_COPY_WRITE_BUFFER, regionBytes * FRAMES, NULL, GL_STREAM_DRAW);
+        }
+    }
+
+    // copy bytes into this frame's region, offset in buffer(), -1 if the region is full
+    GLintptr write(const void *data, size_t bytes, size_t alignment = 16)
+    {
+        // nothing to copy (empty instance list, data may be NULL): an offset in the region
+        if (!bytes)
+            return (GLintptr)(region * regionBytes + std::min(offset, regionBytes));
+        const size_t start = (offset + alignment - 1) / alignment * alignment;
+        if (start + bytes > regionBytes)
+        {
+            if (!Overflows)
+                std::cout << "ERROR::STREAM_BUFFER::FRAME_FULL " << bytes << " bytes, "
+                          << regionBytes << " per frame" << std::endl;
+            Overflows++;
+            return -1;
+        }
+        const GLintptr at = (GLintptr)(region * regionBytes + start);
+        if (Persistent)
+            std::memcpy(mapped + at, data, bytes);
+        else
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferId);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, at, bytes, data);
+        }
+        offset = start + bytes;
+        FrameBytes += bytes;
+        return at;
+    }
+
+    // after the frame's last draw using the buffer
+    void endFrame()
+    {
+        if (Persistent)
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        PeakFrameBytes = std::max(PeakFrameBytes, FrameBytes);
+        TotalBytes += FrameBytes;
+        Frames++;
+    }
+
+    void printReport() const
+    {
+        std::cout << "Stream buffer: " << (Persistent ? "persistent mapped" : "orphaning") << ", "
+                  << FRAMES << " x " << regionBytes / 1024 << " KB, "
+                  << (Frames ? TotalBytes / Frames : 0) << " bytes per frame (peak " << PeakFrameBytes << "), "
+                  << Stalls << " stalls (" << StallMs << " ms)";
+        if (Overflows)
+            std::cout << ", " << Overflows << " writes dropped";
+        std::cout << std::endl;
+    }
+
+private:
+    GLuint bufferId = 0;
+    size_t regionBytes;
+    unsigned char *mapped = NULL;
+    GLsync fences[FRAMES] = {};
+    unsigned int region = 0;
+    size_t offset = 0;
+};
+
+#endif
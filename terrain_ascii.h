@@ -0,0 +1,511 @@
+#ifndef TERRAIN_ASCII_H
+#define TERRAIN_ASCII_H
+
+/*
+* ASCII height field loader
+- Text DEM exports: hmap_001_smooth.txt (504 x 302 doubles), production grids of hundreds of MB
+- The file is memory mapped, cut into chunks at line boundaries, a few chunks per thread
+  of the job system (see job_system.h)
+- Every chunk's numbers are parsed with std::from_chars (no locale, no allocation per number)
+  into its own vector, the vectors are concatenated in chunk order afterwards
+
+* Formats
+- ASCII_GRID: one row of the grid per line, numbers separated by spaces / tabs / commas
+- ASCII_ESRI: ESRI ASCII grid, "ncols", "nrows", "xllcorner", "cellsize", "NODATA_value" ...
+              header lines, then nrows * ncols numbers (line breaks do not matter),
+              NODATA samples are replaced by the lowest valid height
+- ASCII_XYZ:  one "x y z" point per line on a regular grid, any order,
+              rows ordered by descending y (north first, as in ESRI grids),
+              columns by ascending x, missing points get the lowest height,
+              x / y parsed as double (projected coordinates: UTM northings ~ 6.5e6,
+              where a float only has 0.5 m steps), z as float
+- Rows of different lengths / points without 3 columns: reported with the first bad line
+- ASCII_AUTO: ESRI if the file starts with "ncols", XYZ for .xyz files, otherwise GRID
+*/
+
+#include <string>
+#include <vector>
+#include <charconv>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <limits>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+#include "job_system.h"
+
+// read only view of a whole file, memory mapped where possible
+struct MappedFile
+{
+    const char *data = nullptr;
+    size_t size = 0;
+
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::string &path)
+    {
+        close();
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        size = (size_t)st.st_size;
+        if (!size)
+            return true;
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        void *memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping stays valid
+        if (memory == MAP_FAILED)
+        {
+            size = 0;
+            return false;
+        }
+        data = (const char *)memory;
+#else
+        // no mmap -> one read into memory
+        std::ifstream file(path, std::ios::binary);
+        buffer.resize(size);
+        if (!file.read(buffer.data(), size))
+            return false;
+        data = buffer.data();
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (data)
+            munmap((void *)data, size);
+#else
+        buffer = std::vector<char>();
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+#ifdef _WIN32
+private:
+    std::vector<char> buffer;
+#endif
+};
+
+// Defines the text layouts the loader understands
+enum Ascii_Format {
+    ASCII_AUTO,
+    ASCII_GRID,
+    ASCII_ESRI,
+    ASCII_XYZ
+};
+
+class AsciiHeightLoader
+{
+public:
+    // height field of the last load(), Width * Height, row by row
+    int Width = 0;
+    int Height = 0;
+    std::vector<float> Heights;
+    // layout of the last file (never ASCII_AUTO after a load)
+    Ascii_Format Format = ASCII_AUTO;
+    JobSystem *jobs;
+
+    // constructor, NULL -> the shared job system
+    AsciiHeightLoader(JobSystem *jobs = NULL)
+    {
+        this->jobs = jobs ? jobs : &JobSystem::shared();
+    }
+
+    bool load(const std::string &path, Ascii_Format format = ASCII_AUTO)
+    {
+        Width = Height = 0;
+        Heights.clear();
+        MappedFile file;
+        if (!file.open(path))
+        {
+            std::cout << "ERROR::ASCII::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+            return false;
+        }
+        const char *begin = file.data, *end = file.data + file.size;
+        Format = format != ASCII_AUTO ? format : detect(path, begin, end);
+
+        if (Format == ASCII_ESRI)
+            return loadEsri(path, begin, end);
+        if (Format == ASCII_XYZ)
+            return loadXYZ(path, begin, end);
+        return loadGrid(path, begin, end);
+    }
+
+private:
+    // result of one chunk
+    struct Chunk
+    {
+        const char *begin, *end;
+        // the first wideColumns numbers of every line go to coordinates (double), the rest to values
+        size_t wideColumns = 0;
+        std::vector<double> coordinates;
+        std::vector<float> values;
+        size_t lines = 0;                  // lines with at least one number
+        const char *firstLine = nullptr;   // start of the first of these lines
+        size_t firstValues = 0;            // numbers on it
+        const char *raggedLine = nullptr;  // start of the first line with a different count
+        const char *error = nullptr;
+    };
+
+    static bool isSeparator(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ';';
+    }
+
+    static Ascii_Format detect(const std::string &path, const char *begin, const char *end)
+    {
+        const char *p = begin;
+        while (p < end && std::isspace((unsigned char)*p))
+            p++;
+        std::string word;
+        while (p < end && word.size() < 5 && std::isalpha((unsigned char)*p))
+            word += (char)std::tolower((unsigned char)*p++);
+        if (word == "ncols")
+            return ASCII_ESRI;
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, ".xyz") == 0)
+            return ASCII_XYZ;
+        return ASCII_GRID;
+    }
+
+    // one number at p, end of it (nullptr: not a number)
+    template <typename T>
+    static const char *parseNumber(const char *p, const char *end, T &value)
+    {
+        // from_chars does not take a leading '+'
+        if (*p == '+')
+            p++;
+        std::from_chars_result result = std::from_chars(p, end, value);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            // too small / too large for the type: rare, parse as double and clamp
+            const char *q = p;
+            while (q < end && !isSeparator(*q) && *q != '\n')
+                q++;
+            const double wide = std::strtod(std::string(p, q).c_str(), nullptr);
+            const double limit = (double)std::numeric_limits<T>::max();
+            value = (T)std::max(-limit, std::min(limit, wide));
+            return q;
+        }
+        return result.ec == std::errc() ? result.ptr : nullptr;
+    }
+
+    // every number in [chunk.begin, chunk.end), per line bookkeeping for the grid check
+    static void parseChunk(Chunk &chunk)
+    {
+        const char *p = chunk.begin, *end = chunk.end, *line = p;
+        // estimate, exports rarely use less than 8 characters per number
+        chunk.values.reserve((end - p) / 8);
+        size_t count = 0;
+        while (p < end)
+        {
+            const char c = *p;
+            if (isSeparator(c))
+            {
+                p++;
+                continue;
+            }
+            if (c == '\n')
+            {
+                endLine(chunk, line, count);
+                line = ++p;
+                continue;
+            }
+            const char *next;
+            if (count < chunk.wideColumns)
+            {
+                double value = 0.0;
+                next = parseNumber(p, end, value);
+                chunk.coordinates.push_back(value);
+            }
+            else
+            {
+                float value = 0.0f;
+                next = parseNumber(p, end, value);
+                chunk.values.push_back(value);
+            }
+            if (!next)
+            {
+                chunk.error = p;
+                return;
+            }
+            count++;
+            p = next;
+        }
+        endLine(chunk, line, count);
+    }
+
+    static void endLine(Chunk &chunk, const char *line, size_t &count)
+    {
+        if (!count)
+            return;
+        if (!chunk.lines)
+        {
+            chunk.firstLine = line;
+            chunk.firstValues = count;
+        }
+        else if (count != chunk.firstValues && !chunk.raggedLine)
+            chunk.raggedLine = line;
+        chunk.lines++;
+        count = 0;
+    }
+
+    static size_t lineNumber(const char *fileBegin, const char *at)
+    {
+        return std::count(fileBegin, at, '\n') + 1;
+    }
+
+    // start of the first line without exactly columns numbers, nullptr if there is none
+    static const char *badLine(const std::vector<Chunk> &chunks, size_t columns)
+    {
+        for (const Chunk &chunk : chunks)
+        {
+            if (!chunk.lines)
+                continue;
+            if (chunk.firstValues != columns)
+                return chunk.firstLine;
+            if (chunk.raggedLine)
+                return chunk.raggedLine;
+        }
+        return nullptr;
+    }
+
+    // cut [begin, end) into chunks at line starts, parse them in parallel
+    std::vector<Chunk> parse(const char *begin, const char *end, size_t wideColumns = 0) const
+    {
+        const size_t size = end - begin;
+        // small files are not worth a job, 1 MB per chunk at least,
+        // 4 chunks per thread -> a slow chunk does not hold up the others
+        const unsigned int numChunks = (unsigned int)std::max<size_t>(1, std::min<size_t>(jobs->numThreads() * 4, size >> 20));
+        std::vector<Chunk> chunks(numChunks);
+        const char *chunkBegin = begin;
+        for (unsigned int t = 0; t < numChunks; t++)
+        {
+            const char *chunkEnd = t + 1 == numChunks ? end : begin + size * (t + 1) / numChunks;
+            chunkEnd = std::max(chunkEnd, chunkBegin);
+            while (chunkEnd > begin && chunkEnd < end && chunkEnd[-1] != '\n')
+                chunkEnd++;
+            chunks[t].begin = chunkBegin;
+            chunks[t].end = chunkEnd;
+            chunks[t].wideColumns = wideColumns;
+            chunkBegin = chunkEnd;
+        }
+        jobs->parallelFor(0, numChunks, 1, [&chunks](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++)
+                parseChunk(chunks[c]);
+        });
+        return chunks;
+    }
+
+    // numbers of all chunks in file order, false on a parse error
+    bool gather(const std::string &path, std::vector<Chunk> &chunks, const char *fileBegin, std::vector<float> &values) const
+    {
+        size_t total = 0;
+        for (const Chunk &chunk : chunks)
+        {
+            if (chunk.error)
+            {
+                std::cout << "ERROR::ASCII::NOT_A_NUMBER line " << lineNumber(fileBegin, chunk.error) << " in " << path << std::endl;
+                return false;
+            }
+            total += chunk.values.size();
+        }
+        values.resize(total);
+        float *out = values.data();
+        for (Chunk &chunk : chunks)
+        {
+            std::copy(chunk.values.begin(), chunk.values.end(), out);
+            out += chunk.values.size();
+            chunk.values = std::vector<float>();
+        }
+        return true;
+    }
+
+    bool loadGrid(const std::string &path, const char *begin, const char *end)
+    {
+        std::vector<Chunk> chunks = parse(begin, end);
+        // every non empty line must hold as many values as the first one
+        size_t width = 0, rows = 0;
+        for (const Chunk &chunk : chunks)
+        {
+            if (!width)
+                width = chunk.firstValues;
+            rows += chunk.lines;
+        }
+        if (!gather(path, chunks, begin, Heights))
+            return false;
+        if (!width)
+        {
+            std::cout << "ERROR::ASCII::EMPTY " << path << std::endl;
+            return false;
+        }
+        if (const char *ragged = badLine(chunks, width))
+        {
+            std::cout << "ERROR::ASCII::RAGGED_ROWS line " << lineNumber(begin, ragged) << " (" << width
+                      << " values per row expected) in " << path << std::endl;
+            Heights.clear();
+            return false;
+        }
+        Width = (int)width;
+        Height = (int)rows;
+        return true;
+    }
+
+    bool loadEsri(const std::string &path, const char *begin, const char *end)
+    {
+        // header: "key value" lines, as long as the line starts with a letter
+        long ncols = 0, nrows = 0;
+        double noData = 0.0;
+        bool hasNoData = false;
+        const char *p = begin;
+        while (p < end)
+        {
+            const char *lineEnd = (const char *)std::memchr(p, '\n', end - p);
+            lineEnd = lineEnd ? lineEnd + 1 : end;
+            const char *key = p;
+            while (key < lineEnd && std::isspace((unsigned char)*key))
+                key++;
+            if (key == lineEnd || !std::isalpha((unsigned char)*key))
+                break;
+            std::string line(key, lineEnd);
+            std::string name(line.substr(0, line.find_first_of(" \t")));
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+            const double value = std::atof(line.c_str() + name.size());
+            if (name == "ncols")
+                ncols = (long)value;
+            else if (name == "nrows")
+                nrows = (long)value;
+            else if (name == "nodata_value")
+            {
+                noData = value;
+                hasNoData = true;
+            }
+            p = lineEnd;
+        }
+        if (ncols <= 0 || nrows <= 0)
+        {
+            std::cout << "ERROR::ASCII::ESRI_HEADER " << path << std::endl;
+            return false;
+        }
+
+        std::vector<Chunk> chunks = parse(p, end);
+        if (!gather(path, chunks, begin, Heights))
+            return false;
+        if (Heights.size() != (size_t)ncols * nrows)
+        {
+            std::cout << "ERROR::ASCII::ESRI_SIZE " << Heights.size() << " values, expected "
+                      << ncols << " x " << nrows << " in " << path << std::endl;
+            Heights.clear();
+            return false;
+        }
+        if (hasNoData)
+            fillMissing(Heights, [noData](float h) { return h == (float)noData; });
+        Width = (int)ncols;
+        Height = (int)nrows;
+        return true;
+    }
+
+    bool loadXYZ(const std::string &path, const char *begin, const char *end)
+    {
+        // x, y as double, z as float
+        std::vector<Chunk> chunks = parse(begin, end, 2);
+        if (const char *bad = badLine(chunks, 3))
+        {
+            std::cout << "ERROR::ASCII::XYZ_NOT_3_COLUMNS line " << lineNumber(begin, bad) << " in " << path << std::endl;
+            return false;
+        }
+        std::vector<double> coordinates;
+        for (const Chunk &chunk : chunks)
+            coordinates.insert(coordinates.end(), chunk.coordinates.begin(), chunk.coordinates.end());
+        std::vector<float> z;
+        if (!gather(path, chunks, begin, z) || z.empty())
+            return false;
+
+        // grid axes: distinct x / y values, the smallest gap is the grid spacing
+        const size_t count = z.size();
+        std::vector<double> xs(count), ys(count);
+        for (size_t k = 0; k < count; k++)
+        {
+            xs[k] = coordinates[k * 2];
+            ys[k] = coordinates[k * 2 + 1];
+        }
+        double x0, dx, y0, dy;
+        const long width = axis(xs, x0, dx), height = axis(ys, y0, dy);
+        if ((double)width * height > count * 4.0)
+        {
+            // spacing far from regular -> not a grid (no single line to blame)
+            std::cout << "ERROR::ASCII::XYZ_NOT_A_GRID " << count << " points, smallest spacing " << dx << " x " << dy
+                      << " -> " << width << " x " << height << " grid in " << path << std::endl;
+            return false;
+        }
+
+        Heights.assign((size_t)width * height, NAN);
+        for (size_t k = 0; k < count; k++)
+        {
+            const long j = std::lround((coordinates[k * 2] - x0) / dx);
+            // row 0 is the largest y
+            const long i = height - 1 - std::lround((coordinates[k * 2 + 1] - y0) / dy);
+            Heights[(size_t)i * width + j] = z[k];
+        }
+        fillMissing(Heights, [](float h) { return std::isnan(h); });
+        Width = (int)width;
+        Height = (int)height;
+        return true;
+    }
+
+    // samples of a regular axis: first value, spacing, number of samples
+    static long axis(std::vector<double> &values, double &first, double &spacing)
+    {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        first = values.front();
+        spacing = DBL_MAX;
+        for (size_t k = 1; k < values.size(); k++)
+            spacing = std::min(spacing, values[k] - values[k - 1]);
+        if (values.size() < 2)
+        {
+            spacing = 1.0;
+            return 1;
+        }
+        return std::lround((values.back() - first) / spacing) + 1;
+    }
+
+    // missing samples get the lowest valid height
+    template <typename Missing>
+    static void fillMissing(std::vector<float> &heights, Missing missing)
+    {
+        float lowest = FLT_MAX;
+        for (float h : heights)
+        {
+            if (!missing(h))
+                lowest = std::min(lowest, h);
+        }
+        if (lowest == FLT_MAX)
+            lowest = 0.0f;
+        for (float &h : heights)
+        {
+            if (missing(h))
+                h = lowest;
+        }
+    }
+};
+
+#endif
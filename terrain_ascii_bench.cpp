@@ -0,0 +1,65 @@
+/*
+
+* ASCII height field loader benchmark
+- Loads a text height field (grid, ESRI ASCII grid or XYZ) on job systems of 1..N threads
+- Reports MB/s and speed-up over the single threaded load
+- Checks every parallel result against the single threaded one
+
+usage: terrain_ascii_bench [height field path] [max threads] [repetitions]
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include "terrain_ascii.h"
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "./hmap_001_smooth.txt";
+    unsigned int maxThreads = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    int repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    // reference result: no workers, everything in this thread
+    JobSystem serial(1);
+    AsciiHeightLoader reference(&serial);
+    if (!reference.load(path))
+        return -1;
+    struct stat st;
+    stat(path, &st);
+    const double megabytes = st.st_size / (1024.0 * 1024.0);
+    const char *formats[] = {"auto", "grid", "esri", "xyz"};
+    std::cout << path << ": " << std::fixed << std::setprecision(1) << megabytes << " MB, "
+              << formats[reference.Format] << ", " << reference.Width << " x " << reference.Height << std::endl;
+
+    double baseSpeed = 0.0;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "best ms" << std::setw(12) << "MB/s"
+              << std::setw(10) << "speedup" << std::endl;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        // own pool of that many threads (see job_system.h)
+        JobSystem jobs(threads);
+        AsciiHeightLoader loader(&jobs);
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            loader.load(path);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+        if (loader.Heights != reference.Heights || loader.Width != reference.Width)
+        {
+            std::cout << "ERROR::BENCH::HEIGHTS_MISMATCH with " << threads << " threads" << std::endl;
+            return -1;
+        }
+        const double speed = megabytes / best;
+        if (threads == 1)
+            baseSpeed = speed;
+        std::cout << std::setw(8) << threads << std::fixed << std::setprecision(3) << std::setw(12) << best * 1000.0
+                  << std::setprecision(1) << std::setw(12) << speed
+                  << std::setprecision(2) << std::setw(9) << speed / baseSpeed << "x" << std::endl;
+    }
+    return 0;
+}
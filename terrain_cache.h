@@ -0,0 +1,102 @@
+#ifndef TERRAIN_CACHE_H
+#define TERRAIN_CACHE_H
+
+/*
+* Post-transform vertex cache simulation
+- The GPU keeps the outputs of the last few vertex shader runs, an index
+  found in there is not shaded again
+- Replays an index stream through a cache of cacheSize entries:
+    - FIFO: a hit does not change the order, the oldest entry is replaced (most hardware)
+    - LRU:  a hit moves the entry to the front, the least recently used is replaced
+- Triangle strips: every index of the stream is one lookup,
+  degenerate triangles (repeated index) are not counted as triangles
+
+* Metrics
+- ACMR (average cache miss ratio):       misses / triangles, 0.5 at best for a grid
+- ATVR (average transform to vertex ratio): misses / unique vertices, 1.0 at best
+*/
+
+#include <vector>
+#include <algorithm>
+
+// Defines the simulated replacement policies
+enum Cache_Policy {
+    CACHE_FIFO,
+    CACHE_LRU
+};
+
+struct VertexCacheStats
+{
+    unsigned long long lookups = 0;
+    unsigned long long misses = 0;
+    unsigned long long triangles = 0;
+    unsigned long long vertices = 0;
+
+    double acmr() const { return triangles ? (double)misses / triangles : 0.0; }
+    double atvr() const { return vertices ? (double)misses / vertices : 0.0; }
+};
+
+// indices: strips back to back, stripCounts: indices per strip
+// numVertices: size of the vertex buffer the indices point into
+VertexCacheStats simulateVertexCache(const std::vector<unsigned int> &indices,
+                                     const std::vector<unsigned int> &stripCounts,
+                                     unsigned int numVertices,
+                                     unsigned int cacheSize,
+                                     Cache_Policy policy)
+{
+    VertexCacheStats stats;
+    // FIFO: insertion number of every vertex, it stays cached for cacheSize more insertions
+    std::vector<unsigned long long> stamp(numVertices, 0);
+    unsigned long long clock = 0;
+    // LRU: cache entries, most recently used first
+    std::vector<unsigned int> lru;
+    lru.reserve(cacheSize + 1);
+    std::vector<bool> seen(numVertices, false);
+
+    size_t first = 0;
+    for (unsigned int count : stripCounts)
+    {
+        for (size_t k = first; k < first + count; k++)
+        {
+            const unsigned int v = indices[k];
+            stats.lookups++;
+            if (policy == CACHE_FIFO)
+            {
+                if (!stamp[v] || clock - stamp[v] >= cacheSize)
+                {
+                    stats.misses++;
+                    stamp[v] = ++clock;
+                }
+            }
+            else
+            {
+                std::vector<unsigned int>::iterator entry = std::find(lru.begin(), lru.end(), v);
+                if (entry == lru.end())
+                {
+                    stats.misses++;
+                    if (lru.size() == cacheSize)
+                        lru.pop_back();
+                }
+                else
+                    lru.erase(entry);
+                lru.insert(lru.begin(), v);
+            }
+            if (!seen[v])
+            {
+                seen[v] = true;
+                stats.vertices++;
+            }
+            // triangle (k - 2, k - 1, k) of the strip
+            if (k >= first + 2)
+            {
+                const unsigned int a = indices[k - 2], b = indices[k - 1];
+                if (a != b && b != v && a != v)
+                    stats.triangles++;
+            }
+        }
+        first += count;
+    }
+    return stats;
+}
+
+#endif
@@ -0,0 +1,72 @@
+/*
+
+* Terrain vertex cache analyzer
+- Builds the strip indices of height_map.cpp (tiles of 64 x 64 quads) with several
+  strip widths and replays them through simulated FIFO / LRU vertex caches
+- Reports ACMR / ATVR per strip width and cache size, "tile row" is one strip
+  per tile row (the layout without bands)
+- Only the grid size of the height map matters, the heights do not
+- A band of w quads needs 2 * w + 2 cache entries to reuse the shared row:
+  widths 31, 15, 11, 7 fit caches of 64, 32, 24, 16 entries
+
+usage: terrain_cache_bench [height map path] [cache size] [tile size]
+       cache size 0 -> 16, 24, 32 and 64 entries
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "terrain_mesh.h"
+#include "terrain_cache.h"
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "./img/iceland_heightmap.png";
+    unsigned int cacheSize = argc > 2 ? std::atoi(argv[2]) : 0;
+    unsigned int tileSize = argc > 3 ? std::atoi(argv[3]) : 64;
+
+    int width, height, nChannels;
+    unsigned char *data = stbi_load(path, &width, &height, &nChannels, 0);
+    if (!data)
+    {
+        std::cout << "Failed to load texture" << std::endl;
+        return -1;
+    }
+    std::cout << path << ": " << width << " x " << height << ", tiles of " << tileSize << " quads" << std::endl;
+
+    std::vector<unsigned int> cacheSizes;
+    if (cacheSize)
+        cacheSizes.push_back(cacheSize);
+    else
+        cacheSizes = {16, 24, 32, 64};
+
+    std::cout << std::left << std::setw(12) << "strips" << std::right << std::setw(8) << "cache"
+              << std::setw(12) << "FIFO ACMR" << std::setw(12) << "FIFO ATVR"
+              << std::setw(12) << "LRU ACMR" << std::setw(12) << "LRU ATVR" << std::endl;
+    for (unsigned int stripWidth : {0u, 31u, 15u, 11u, 7u})
+    {
+        if (stripWidth >= tileSize)
+            continue;
+        TerrainMeshBuilder mesh(NULL, tileSize);
+        mesh.padToTiles = true;
+        mesh.stripWidth = stripWidth;
+        mesh.build(data, width, height, nChannels);
+        const unsigned int numVertices = (unsigned int)(mesh.vertices.size() / 3);
+        const std::string name = stripWidth ? std::to_string(stripWidth) + " quads" : "tile row";
+        for (unsigned int size : cacheSizes)
+        {
+            VertexCacheStats fifo = simulateVertexCache(mesh.indices, mesh.stripCounts, numVertices, size, CACHE_FIFO);
+            VertexCacheStats lru = simulateVertexCache(mesh.indices, mesh.stripCounts, numVertices, size, CACHE_LRU);
+            std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << size
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(12) << fifo.acmr() << std::setw(12) << fifo.atvr()
+                      << std::setw(12) << lru.acmr() << std::setw(12) << lru.atvr() << std::endl;
+        }
+    }
+    stbi_image_free(data);
+    return 0;
+}
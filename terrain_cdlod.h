@@ -0,0 +1,384 @@
+#ifndef TERRAIN_CDLOD_H
+#define TERRAIN_CDLOD_H
+
+/*
+* CDLOD (Continuous Distance-Dependent Level of Detail)
+- Quadtree over the height map: a node at level l covers leafSize * 2^l quads
+- Geometry is ONE grid patch of patchSize x patchSize quads, drawn instanced
+  once per selected node: node origin, vertex spacing (2^l) and level per instance
+- Heights come from a float texture in the vertex shader (height_cdlod.vs)
+  -> GPU memory for geometry does not grow with the height map
+
+* Selection
+- Level l is used up to distance range(l) = LodRange * 2^l from the camera
+- Walk down from the root nodes:
+    - outside the frustum                    -> skip
+    - leaf, or children not within range(l-1) -> select the node at level l
+    - otherwise, per child:
+        - within range(l-1)                  -> recurse into the child
+        - beyond range(l-1)                  -> select the node's quadrant at level l
+- A quadrant is drawn with the first quarter of the patch (indices ordered by quadrant),
+  at the parent's spacing -> no selected node is ever farther than its own range, so
+  neighbours across an edge are never more than one morph band apart (no T-junction cracks)
+- Only nodes near the camera are refined -> cost grows with log(size), not with texels
+- Min / max height per node (for the bounding boxes) is precomputed level by level
+
+* Geomorphing
+- Between MorphStart * range(l) and range(l) the odd vertices of a level l patch
+  slide onto the even ones -> at range(l) the patch equals the level l+1 grid
+- Patch triangles are split along the (i, j) - (i+1, j+1) diagonal, so the
+  collapsed fine triangles line up exactly with the coarse ones
+*/
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cfloat>
+#include <algorithm>
+#include "shaders.h"
+#include "stream_buffer.h"
+#include "terrain_tiles.h"
+
+class TerrainCDLOD
+{
+public:
+    // distance covered by level 0, doubles with every level
+    float LodRange = 256.0f;
+    // fraction of the range where morphing to the next level starts
+    float MorphStart = 0.7f;
+
+    // stats of the last select()
+    unsigned int SelectedNodes = 0;
+    unsigned int VisitedNodes = 0;
+    unsigned int Triangles = 0;
+    unsigned int DrawCalls = 0;
+    unsigned int NodesPerLevel[16] = {};
+
+    // heights: world space height per grid vertex, width * height, row by row
+    // origin: world (x, z) of grid vertex (0, 0)
+    // patchSize: rounded down to a multiple of 4 (a quadrant starts on an even vertex)
+    TerrainCDLOD(const std::vector<float> &heights, int width, int height, glm::vec2 origin,
+                 unsigned int leafSize = 64, unsigned int patchSize = 64);
+
+    // choose the nodes to draw this frame
+    void select(const glm::vec3 &cameraPos, const Frustum &frustum);
+    // set the CDLOD uniforms and draw the selected nodes, shader must be in use
+    // (camera position from the per-frame block, see frame_uniforms.h),
+    // the nodes are streamed through stream (see stream_buffer.h)
+    void draw(Shader &shader, StreamBuffer &stream);
+    // draw level by level, tinting every level with its color
+    void drawDebug(Shader &shader, StreamBuffer &stream, const glm::vec3 *colors, int numColors);
+
+    unsigned int numLevels() const { return levels; }
+
+private:
+    int gridWidth, gridHeight;
+    glm::vec2 gridOrigin;
+    unsigned int leafSize, patchSize, levels;
+    GLuint vao, patchVBO, patchEBO, heightTexture;
+    GLsizei patchIndices;
+
+    // per level: nodes along rows / columns, min / max height per node
+    std::vector<unsigned int> nodesX, nodesZ;
+    std::vector<std::vector<float>> nodeMin, nodeMax;
+
+    // selected nodes: row, column, spacing, level (instance attribute),
+    // whole nodes first, then quadrants (numNodes on), each group sorted by level
+    std::vector<glm::vec4> instances, quadrants;
+    unsigned int numNodes = 0;
+    // per group: first instance of every level
+    std::vector<unsigned int> levelFirst[2];
+    // offset of the instances in the stream buffer this frame
+    GLintptr instanceOffset = 0;
+
+    void buildPatch();
+    void buildTree(const std::vector<float> &heights);
+    void selectNode(unsigned int level, unsigned int nx, unsigned int nz, const glm::vec3 &cameraPos, const Frustum &frustum);
+    void nodeBounds(unsigned int level, unsigned int nx, unsigned int nz, glm::vec3 &boxMin, glm::vec3 &boxMax) const;
+    bool inRange(unsigned int level, const glm::vec3 &cameraPos, const glm::vec3 &boxMin, const glm::vec3 &boxMax) const;
+    // false: the instances did not fit into the stream buffer
+    bool setUniforms(Shader &shader, StreamBuffer &stream);
+};
+
+TerrainCDLOD::TerrainCDLOD(const std::vector<float> &heights, int width, int height, glm::vec2 origin,
+                           unsigned int leafSize, unsigned int patchSize)
+    : gridWidth(width), gridHeight(height), gridOrigin(origin), leafSize(leafSize), patchSize(std::max(4u, patchSize / 4 * 4))
+{
+    // enough levels for a single root to cover the whole grid
+    levels = 1;
+    while ((leafSize << (levels - 1)) < (unsigned int)std::max(width, height) - 1 && levels < 16)
+        levels++;
+
+    buildPatch();
+    buildTree(heights);
+
+    // heights as a single channel float texture, linear filtering for the morphed positions
+    glGenTextures(1, &heightTexture);
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, heights.data());
+}
+
+void TerrainCDLOD::buildPatch()
+{
+    // (patchSize + 1)^2 grid positions, shared by every node
+    std::vector<float> grid;
+    for (unsigned int i = 0; i <= patchSize; i++)
+    {
+        for (unsigned int j = 0; j <= patchSize; j++)
+        {
+            grid.push_back((float)i);
+            grid.push_back((float)j);
+        }
+    }
+    // quadrant by quadrant -> the first quarter of the indices is the (0, 0) quadrant alone
+    std::vector<unsigned int> indices;
+    const unsigned int row = patchSize + 1, half = patchSize / 2;
+    for (unsigned int qi = 0; qi < patchSize; qi += half)
+    {
+        for (unsigned int qj = 0; qj < patchSize; qj += half)
+        {
+            for (unsigned int i = qi; i < qi + half; i++)
+            {
+                for (unsigned int j = qj; j < qj + half; j++)
+                {
+                    unsigned int v00 = i * row + j, v01 = v00 + 1, v10 = v00 + row, v11 = v10 + 1;
+                    // diagonal 00 - 11, same winding as the row strips
+                    indices.insert(indices.end(), {v00, v10, v11, v00, v11, v01});
+                }
+            }
+        }
+    }
+    patchIndices = (GLsizei)indices.size();
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &patchVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, patchVBO);
+    glBufferData(GL_ARRAY_BUFFER, grid.size() * sizeof(float), grid.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void *)0);
+    glEnableVertexAttribArray(0);
+
+    glGenBuffers(1, &patchEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patchEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // per node attribute, advances once per instance, pointed into the stream buffer every frame
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+
+    glBindVertexArray(0);
+}
+
+void TerrainCDLOD::buildTree(const std::vector<float> &heights)
+{
+    nodesX.resize(levels);
+    nodesZ.resize(levels);
+    nodeMin.resize(levels);
+    nodeMax.resize(levels);
+
+    // leaves: min / max over their (leafSize + 1)^2 vertices, clipped to the grid
+    const unsigned int quadRows = gridHeight - 1, quadCols = gridWidth - 1;
+    nodesX[0] = (quadRows + leafSize - 1) / leafSize;
+    nodesZ[0] = (quadCols + leafSize - 1) / leafSize;
+    nodeMin[0].assign(nodesX[0] * nodesZ[0], FLT_MAX);
+    nodeMax[0].assign(nodesX[0] * nodesZ[0], -FLT_MAX);
+    for (unsigned int i = 0; i <= quadRows; i++)
+    {
+        // a vertex on a node border belongs to both nodes
+        unsigned int nx0 = std::min(i / leafSize, nodesX[0] - 1), nx1 = i > 0 ? std::min((i - 1) / leafSize, nodesX[0] - 1) : nx0;
+        for (unsigned int j = 0; j <= quadCols; j++)
+        {
+            unsigned int nz0 = std::min(j / leafSize, nodesZ[0] - 1), nz1 = j > 0 ? std::min((j - 1) / leafSize, nodesZ[0] - 1) : nz0;
+            float h = heights[(size_t)i * gridWidth + j];
+            for (unsigned int nx : {nx0, nx1})
+            {
+                for (unsigned int nz : {nz0, nz1})
+                {
+                    float &lo = nodeMin[0][nx * nodesZ[0] + nz], &hi = nodeMax[0][nx * nodesZ[0] + nz];
+                    lo = std::min(lo, h);
+                    hi = std::max(hi, h);
+                }
+            }
+        }
+    }
+
+    // parents: reduce the (up to) four children
+    for (unsigned int level = 1; level < levels; level++)
+    {
+        nodesX[level] = (nodesX[level - 1] + 1) / 2;
+        nodesZ[level] = (nodesZ[level - 1] + 1) / 2;
+        nodeMin[level].assign(nodesX[level] * nodesZ[level], FLT_MAX);
+        nodeMax[level].assign(nodesX[level] * nodesZ[level], -FLT_MAX);
+        for (unsigned int nx = 0; nx < nodesX[level - 1]; nx++)
+        {
+            for (unsigned int nz = 0; nz < nodesZ[level - 1]; nz++)
+            {
+                unsigned int child = nx * nodesZ[level - 1] + nz, parent = nx / 2 * nodesZ[level] + nz / 2;
+                nodeMin[level][parent] = std::min(nodeMin[level][parent], nodeMin[level - 1][child]);
+                nodeMax[level][parent] = std::max(nodeMax[level][parent], nodeMax[level - 1][child]);
+            }
+        }
+    }
+}
+
+void TerrainCDLOD::nodeBounds(unsigned int level, unsigned int nx, unsigned int nz, glm::vec3 &boxMin, glm::vec3 &boxMax) const
+{
+    const float size = (float)(leafSize << level);
+    const unsigned int node = nx * nodesZ[level] + nz;
+    boxMin = glm::vec3(gridOrigin.x + nx * size, nodeMin[level][node], gridOrigin.y + nz * size);
+    boxMax = glm::vec3(gridOrigin.x + std::min((nx + 1) * size, (float)(gridHeight - 1)), nodeMax[level][node],
+                       gridOrigin.y + std::min((nz + 1) * size, (float)(gridWidth - 1)));
+}
+
+bool TerrainCDLOD::inRange(unsigned int level, const glm::vec3 &cameraPos, const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+{
+    // sphere of radius range(level) around the camera vs the node's box
+    glm::vec3 closest = glm::max(boxMin, glm::min(cameraPos, boxMax));
+    float range = LodRange * (float)(1u << level);
+    glm::vec3 d = closest - cameraPos;
+    return glm::dot(d, d) <= range * range;
+}
+
+void TerrainCDLOD::select(const glm::vec3 &cameraPos, const Frustum &frustum)
+{
+    instances.clear();
+    quadrants.clear();
+    VisitedNodes = 0;
+    const unsigned int top = levels - 1;
+    for (unsigned int nx = 0; nx < nodesX[top]; nx++)
+    {
+        for (unsigned int nz = 0; nz < nodesZ[top]; nz++)
+            selectNode(top, nx, nz, cameraPos, frustum);
+    }
+
+    // group instances by level -> the debug view can draw level by level
+    const auto byLevel = [](const glm::vec4 &a, const glm::vec4 &b) { return a.w < b.w; };
+    std::stable_sort(instances.begin(), instances.end(), byLevel);
+    std::stable_sort(quadrants.begin(), quadrants.end(), byLevel);
+    numNodes = (unsigned int)instances.size();
+    instances.insert(instances.end(), quadrants.begin(), quadrants.end());
+    std::fill(NodesPerLevel, NodesPerLevel + 16, 0);
+    for (unsigned int group = 0; group < 2; group++)
+    {
+        levelFirst[group].assign(levels + 1, group ? numNodes : 0);
+        unsigned int level = 0;
+        for (unsigned int i = levelFirst[group][0]; i < (group ? instances.size() : numNodes); i++)
+        {
+            // instances sorted by level -> the first of every level up to this one
+            for (; level < (unsigned int)instances[i].w; level++)
+                levelFirst[group][level + 1] = i;
+            NodesPerLevel[level]++;
+        }
+        for (; level < levels; level++)
+            levelFirst[group][level + 1] = group ? (unsigned int)instances.size() : numNodes;
+    }
+
+    SelectedNodes = (unsigned int)instances.size();
+    Triangles = (numNodes * patchIndices + (SelectedNodes - numNodes) * (patchIndices / 4)) / 3;
+}
+
+void TerrainCDLOD::selectNode(unsigned int level, unsigned int nx, unsigned int nz, const glm::vec3 &cameraPos, const Frustum &frustum)
+{
+    VisitedNodes++;
+    glm::vec3 boxMin, boxMax;
+    nodeBounds(level, nx, nz, boxMin, boxMax);
+    if (!frustum.intersects(boxMin, boxMax))
+        return;
+
+    // refine only where the finer level's range reaches the node
+    if (level == 0 || !inRange(level - 1, cameraPos, boxMin, boxMax))
+    {
+        const float spacing = (float)(leafSize << level) / patchSize;
+        instances.push_back(glm::vec4((float)(nx * (leafSize << level)), (float)(nz * (leafSize << level)), spacing, (float)level));
+        return;
+    }
+    const unsigned int childSize = leafSize << (level - 1);
+    for (unsigned int cx = nx * 2; cx < std::min(nx * 2 + 2, nodesX[level - 1]); cx++)
+    {
+        for (unsigned int cz = nz * 2; cz < std::min(nz * 2 + 2, nodesZ[level - 1]); cz++)
+        {
+            glm::vec3 childMin, childMax;
+            nodeBounds(level - 1, cx, cz, childMin, childMax);
+            if (inRange(level - 1, cameraPos, childMin, childMax))
+                selectNode(level - 1, cx, cz, cameraPos, frustum);
+            else if (frustum.intersects(childMin, childMax))
+            {
+                // beyond its own range: this node's quadrant, at this node's level
+                const float spacing = (float)(leafSize << level) / patchSize;
+                quadrants.push_back(glm::vec4((float)(cx * childSize), (float)(cz * childSize), spacing, (float)level));
+            }
+        }
+    }
+}
+
+bool TerrainCDLOD::setUniforms(Shader &shader, StreamBuffer &stream)
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    shader.setInt("heightMap", 0);
+    shader.setVec2("gridOrigin", gridOrigin);
+    shader.setVec2("gridSize", glm::vec2((float)gridHeight, (float)gridWidth));
+    shader.setVec2("lodRange", glm::vec2(LodRange, MorphStart));
+
+    // instance data changes every frame
+    instanceOffset = stream.write(instances.data(), instances.size() * sizeof(glm::vec4), sizeof(glm::vec4));
+    if (instanceOffset < 0)
+        return false;
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)instanceOffset);
+    return true;
+}
+
+void TerrainCDLOD::draw(Shader &shader, StreamBuffer &stream)
+{
+    DrawCalls = 0;
+    if (!setUniforms(shader, stream))
+        return;
+    if (numNodes)
+    {
+        glDrawElementsInstanced(GL_TRIANGLES, patchIndices, GL_UNSIGNED_INT, (void *)0, (GLsizei)numNodes);
+        DrawCalls++;
+    }
+    if (instances.size() > numNodes)
+    {
+        // quadrants: the first quarter of the patch, instances from numNodes on
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)(instanceOffset + sizeof(glm::vec4) * numNodes));
+        glDrawElementsInstanced(GL_TRIANGLES, patchIndices / 4, GL_UNSIGNED_INT, (void *)0, (GLsizei)(instances.size() - numNodes));
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)instanceOffset);
+        DrawCalls++;
+    }
+}
+
+void TerrainCDLOD::drawDebug(Shader &shader, StreamBuffer &stream, const glm::vec3 *colors, int numColors)
+{
+    DrawCalls = 0;
+    if (!setUniforms(shader, stream))
+        return;
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        if (!NodesPerLevel[level])
+            continue;
+        shader.setVec3("lodColor", colors[level % numColors]);
+        // whole nodes, then quadrants (first quarter of the patch)
+        for (unsigned int group = 0; group < 2; group++)
+        {
+            const unsigned int first = levelFirst[group][level], count = levelFirst[group][level + 1] - first;
+            if (!count)
+                continue;
+            // no base instance in GL 3.3 -> point the instance attribute at the level's first node
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)(instanceOffset + sizeof(glm::vec4) * first));
+            glDrawElementsInstanced(GL_TRIANGLES, group ? patchIndices / 4 : patchIndices, GL_UNSIGNED_INT, (void *)0, count);
+            DrawCalls++;
+        }
+    }
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (void *)instanceOffset);
+}
+
+#endif
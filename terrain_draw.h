@@ -0,0 +1,284 @@
+#ifndef TERRAIN_DRAW_H
+#define TERRAIN_DRAW_H
+
+/*
+* Terrain draw submission
+- The terrain is a list of triangle strips, grouped into batches (tiles)
+- Same triangles, different ways of handing them to the driver:
+    - PER_STRIP:          one glDrawElements per strip
+    - MULTI_DRAW:         one glMultiDrawElements with all strip offsets / counts
+    - PRIMITIVE_RESTART:  strips separated by a restart index, one glDrawElements
+    - DEGENERATE_STRIP:   strips stitched by repeating the last / first index,
+                          one glDrawElements with zero-area triangles in between
+- Batches are laid out back to back in every buffer
+  -> a run of consecutive visible batches is still a single draw
+- Which one is cheapest depends on the driver -> switchable at runtime,
+  average frame time of each mode is reported on exit
+*/
+
+#include <glad/glad.h>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+// Defines the possible submission modes, in the order of the number keys that select them
+enum Draw_Mode {
+    PER_STRIP,
+    MULTI_DRAW,
+    PRIMITIVE_RESTART,
+    DEGENERATE_STRIP,
+    NUM_DRAW_MODES
+};
+
+const char *const DRAW_MODE_NAMES[NUM_DRAW_MODES] = {
+    "per-strip",
+    "multi-draw",
+    "primitive restart",
+    "degenerate strip"
+};
+
+const GLuint RESTART_INDEX = 0xFFFFFFFF;
+
+class TerrainDraw
+{
+public:
+    // current submission mode
+    Draw_Mode Mode;
+    // draw calls issued by the last draw()
+    unsigned int DrawCalls = 0;
+
+    // constructor uploads one index buffer per layout, built from the strip indices
+    // stripCounts: indices per strip, batchStrips: first strip of each batch + end
+    TerrainDraw(const std::vector<unsigned int> &stripIndices,
+                const std::vector<unsigned int> &stripCounts,
+                const std::vector<unsigned int> &batchStrips,
+                Draw_Mode mode = PER_STRIP);
+
+    // switch submission mode, the first frame after a switch is not counted
+    void setMode(Draw_Mode mode);
+    // draw the whole terrain with the current mode, terrain VAO must be bound
+    void draw();
+    // draw the given batches only, ascending order, terrain VAO must be bound
+    void draw(const std::vector<unsigned int> &batches);
+
+    // frame time bookkeeping for the current mode
+    void recordFrame(double seconds);
+    void printReport() const;
+
+private:
+    GLuint stripEBO, restartEBO, degenerateEBO;
+    std::vector<unsigned int> batchStrips;
+    std::vector<unsigned int> allBatches;
+
+    // per strip offset / count in the strip buffer
+    std::vector<GLsizei> stripCounts;
+    std::vector<const void *> stripOffsets;
+    // per batch first index in the restart / degenerate buffers, plus the buffer end
+    std::vector<size_t> restartBegin, degenerateBegin;
+
+    // glMultiDrawElements arguments gathered every frame
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+
+    // per mode frame statistics
+    unsigned long frames[NUM_DRAW_MODES] = {};
+    double seconds[NUM_DRAW_MODES] = {};
+    double minSeconds[NUM_DRAW_MODES] = {};
+    unsigned long draws[NUM_DRAW_MODES] = {};
+    bool skipFrame = true;
+
+    GLuint upload(const std::vector<unsigned int> &indices);
+    void drawRuns(GLuint ebo, const std::vector<size_t> &begin, size_t separator, const std::vector<unsigned int> &batches);
+};
+
+TerrainDraw::TerrainDraw(const std::vector<unsigned int> &stripIndices,
+                         const std::vector<unsigned int> &counts,
+                         const std::vector<unsigned int> &batches,
+                         Draw_Mode mode)
+    : Mode(mode), batchStrips(batches)
+{
+    const size_t numStrips = counts.size();
+    const size_t numBatches = batchStrips.size() - 1;
+    for (unsigned int batch = 0; batch < numBatches; batch++)
+        allBatches.push_back(batch);
+
+    // * strips back to back, as built
+    stripEBO = upload(stripIndices);
+    stripCounts.resize(numStrips);
+    stripOffsets.resize(numStrips);
+    size_t first = 0;
+    for (size_t strip = 0; strip < numStrips; strip++)
+    {
+        stripCounts[strip] = (GLsizei)counts[strip];
+        stripOffsets[strip] = (void *)(sizeof(unsigned int) * first);
+        first += counts[strip];
+    }
+
+    // * strips separated by the restart index (also between batches)
+    std::vector<unsigned int> restart;
+    restart.reserve(stripIndices.size() + numStrips);
+    first = 0;
+    for (size_t batch = 0; batch < numBatches; batch++)
+    {
+        restartBegin.push_back(restart.size());
+        for (unsigned int strip = batchStrips[batch]; strip < batchStrips[batch + 1]; strip++)
+        {
+            if (strip > 0)
+                restart.push_back(RESTART_INDEX);
+            restart.insert(restart.end(), &stripIndices[first], &stripIndices[first] + counts[strip]);
+            first += counts[strip];
+        }
+    }
+    restartBegin.push_back(restart.size());
+    restartEBO = upload(restart);
+    restart = std::vector<unsigned int>(); // free memory before building the next one
+
+    // * strips stitched with two degenerate indices: last of strip k, first of strip k+1
+    // every strip has an even number of indices -> winding order stays the same
+    std::vector<unsigned int> degenerate;
+    degenerate.reserve(stripIndices.size() + 2 * numStrips);
+    first = 0;
+    for (size_t batch = 0; batch < numBatches; batch++)
+    {
+        degenerateBegin.push_back(degenerate.size());
+        for (unsigned int strip = batchStrips[batch]; strip < batchStrips[batch + 1]; strip++)
+        {
+            if (strip > 0)
+            {
+                degenerate.push_back(degenerate.back());
+                degenerate.push_back(stripIndices[first]);
+            }
+            degenerate.insert(degenerate.end(), &stripIndices[first], &stripIndices[first] + counts[strip]);
+            first += counts[strip];
+        }
+    }
+    degenerateBegin.push_back(degenerate.size());
+    degenerateEBO = upload(degenerate);
+}
+
+GLuint TerrainDraw::upload(const std::vector<unsigned int> &indices)
+{
+    GLuint ebo;
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 indices.size() * sizeof(unsigned int), // size of indices buffer
+                 indices.data(),                        // pointer to first element
+                 GL_STATIC_DRAW);
+    return ebo;
+}
+
+void TerrainDraw::setMode(Draw_Mode mode)
+{
+    if (mode == Mode)
+        return;
+    Mode = mode;
+    skipFrame = true;
+    std::cout << "Draw mode: " << DRAW_MODE_NAMES[Mode] << std::endl;
+}
+
+void TerrainDraw::draw()
+{
+    draw(allBatches);
+}
+
+void TerrainDraw::draw(const std::vector<unsigned int> &batches)
+{
+    DrawCalls = 0;
+    // the element buffer binding is VAO state -> rebind the one matching the mode
+    switch (Mode)
+    {
+    case PER_STRIP:
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stripEBO);
+        for (unsigned int batch : batches)
+        {
+            for (unsigned int strip = batchStrips[batch]; strip < batchStrips[batch + 1]; ++strip)
+            {
+                // draw strip by strip
+                glDrawElements(GL_TRIANGLE_STRIP, stripCounts[strip], GL_UNSIGNED_INT, stripOffsets[strip]);
+                DrawCalls++;
+            }
+        }
+        break;
+    case MULTI_DRAW:
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, stripEBO);
+        counts.clear();
+        offsets.clear();
+        for (unsigned int batch : batches)
+        {
+            counts.insert(counts.end(), &stripCounts[batchStrips[batch]], &stripCounts[0] + batchStrips[batch + 1]);
+            offsets.insert(offsets.end(), &stripOffsets[batchStrips[batch]], &stripOffsets[0] + batchStrips[batch + 1]);
+        }
+        if (!counts.empty())
+        {
+            glMultiDrawElements(GL_TRIANGLE_STRIP, counts.data(), GL_UNSIGNED_INT, offsets.data(), (GLsizei)counts.size());
+            DrawCalls++;
+        }
+        break;
+    case PRIMITIVE_RESTART:
+        glEnable(GL_PRIMITIVE_RESTART);
+        glPrimitiveRestartIndex(RESTART_INDEX);
+        drawRuns(restartEBO, restartBegin, 1, batches);
+        glDisable(GL_PRIMITIVE_RESTART);
+        break;
+    case DEGENERATE_STRIP:
+        drawRuns(degenerateEBO, degenerateBegin, 2, batches);
+        break;
+    default:
+        break;
+    }
+}
+
+// one glDrawElements per run of consecutive batches
+// separator: indices between two batches that a run must not start with
+void TerrainDraw::drawRuns(GLuint ebo, const std::vector<size_t> &begin, size_t separator, const std::vector<unsigned int> &batches)
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    for (size_t i = 0; i < batches.size();)
+    {
+        size_t j = i + 1;
+        while (j < batches.size() && batches[j] == batches[j - 1] + 1)
+            j++;
+        size_t first = begin[batches[i]] + (batches[i] > 0 ? separator : 0);
+        size_t last = begin[batches[j - 1] + 1];
+        glDrawElements(GL_TRIANGLE_STRIP, (GLsizei)(last - first), GL_UNSIGNED_INT, (void *)(sizeof(unsigned int) * first));
+        DrawCalls++;
+        i = j;
+    }
+}
+
+void TerrainDraw::recordFrame(double frameSeconds)
+{
+    // first frame after a switch still carries the previous mode's work
+    if (skipFrame)
+    {
+        skipFrame = false;
+        return;
+    }
+    if (frames[Mode] == 0 || frameSeconds < minSeconds[Mode])
+        minSeconds[Mode] = frameSeconds;
+    frames[Mode]++;
+    seconds[Mode] += frameSeconds;
+    draws[Mode] += DrawCalls;
+}
+
+void TerrainDraw::printReport() const
+{
+    std::cout << "Frame time per draw mode" << std::endl;
+    std::cout << std::left << std::setw(20) << "mode" << std::right << std::setw(10) << "frames"
+              << std::setw(12) << "avg ms" << std::setw(12) << "min ms" << std::setw(12) << "draws" << std::endl;
+    for (int mode = 0; mode < NUM_DRAW_MODES; mode++)
+    {
+        std::cout << std::left << std::setw(20) << DRAW_MODE_NAMES[mode] << std::right << std::setw(10) << frames[mode];
+        if (frames[mode] > 0)
+            std::cout << std::fixed << std::setprecision(3)
+                      << std::setw(12) << seconds[mode] / frames[mode] * 1000.0
+                      << std::setw(12) << minSeconds[mode] * 1000.0
+                      << std::setw(12) << std::setprecision(1) << (double)draws[mode] / frames[mode];
+        else
+            std::cout << std::setw(12) << "-" << std::setw(12) << "-" << std::setw(12) << "-";
+        std::cout << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef TERRAIN_GRID_H
+#define TERRAIN_GRID_H
+
+/*
+* Full resolution grid without the big index buffer
+- The strip indices of the mesh builder are a pure function of (row, column),
+  for the Iceland map they are the largest buffers uploaded at startup
+- Two ways to draw the same triangles without them:
+
+* Shared tile indices
+- One index buffer for a single tile: its strips stitched with degenerate
+  triangles, indices relative to the tile's first vertex (i * gridWidth + j)
+- Every tile of the padded grid has the same size -> the buffer serves all tiles,
+  glMultiDrawElementsBaseVertex draws the visible ones in one call
+- Works with every vertex format (gl_VertexID includes the base vertex)
+
+* Vertex ID grid
+- No index buffer at all: glDrawArraysInstanced, one instance per visible tile,
+  the first (row, column) of the tile is a per instance attribute
+- height_shader.vs turns gl_VertexID into (row, column) inside the tile, in the
+  permutation built with "VERTEX_ID_GRID <tile size>" (the tile size compiled in),
+  2 * T + 4 vertices per strip row r, m = id % (2 * T + 4):
+    m <= 2 * T + 1 -> (r + m % 2, m / 2), the strip of row r
+    m == 2 * T + 2 -> last vertex of row r again
+    m == 2 * T + 3 -> first vertex of row r + 1
+  -> the same degenerate stitching as the shared tile indices
+- No vertex buffer either -> heights come from the texture of the TEXTURE format
+*/
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "stream_buffer.h"
+
+class TerrainGrid
+{
+public:
+    // draw calls issued by the last draw
+    unsigned int DrawCalls = 0;
+
+    // grid of width * height vertices, cut into tiles of tileSize x tileSize quads
+    // (padded to whole tiles, see TerrainMeshBuilder::padToTiles)
+    TerrainGrid(int width, int height, unsigned int tileSize);
+
+    // shared tile indices, visible tiles in TerrainTiles order, VAO of a vertex format must be bound
+    void drawTileIndices(const std::vector<unsigned int> &tiles);
+    // vertex id grid, binds its own VAO, the TEXTURE format must be bound to the shader
+    // (built with VERTEX_ID_GRID <tileSize>), tile origins streamed through stream (see stream_buffer.h)
+    void drawVertexID(const std::vector<unsigned int> &tiles, StreamBuffer &stream);
+
+    // index memory of the shared tile buffer
+    size_t indexBytes() const { return tileIndexCount * sizeof(unsigned int); }
+
+private:
+    int gridWidth;
+    unsigned int tileSize, tilesZ;
+    GLuint tileEBO, vao;
+    GLsizei tileIndexCount;
+
+    // per frame arguments
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+    std::vector<GLint> baseVertices;
+    std::vector<glm::vec2> tileOrigins;
+};
+
+TerrainGrid::TerrainGrid(int width, int height, unsigned int tileSize)
+    : gridWidth(width), tileSize(tileSize)
+{
+    tilesZ = (width - 1) / tileSize;
+
+    // one tile: tileSize strips, two degenerate indices between them
+    std::vector<unsigned int> indices;
+    for (unsigned int i = 0; i < tileSize; i++)
+    {
+        if (i > 0)
+        {
+            indices.push_back(indices.back());
+            indices.push_back(i * width);
+        }
+        for (unsigned int j = 0; j <= tileSize; j++)
+        {
+            indices.push_back(j + width * i);
+            indices.push_back(j + width * (i + 1));
+        }
+    }
+    tileIndexCount = (GLsizei)indices.size();
+    glGenBuffers(1, &tileEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tileEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // vertex id grid: no vertex data, only the tile origin per instance (pointed into the stream buffer)
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+}
+
+void TerrainGrid::drawTileIndices(const std::vector<unsigned int> &tiles)
+{
+    // the element buffer binding is VAO state -> bind it into the current VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tileEBO);
+    counts.assign(tiles.size(), tileIndexCount);
+    offsets.assign(tiles.size(), (const void *)0);
+    baseVertices.clear();
+    for (unsigned int tile : tiles)
+        baseVertices.push_back((GLint)((tile / tilesZ) * tileSize * gridWidth + (tile % tilesZ) * tileSize));
+    DrawCalls = 0;
+    if (!tiles.empty())
+    {
+        glMultiDrawElementsBaseVertex(GL_TRIANGLE_STRIP, counts.data(), GL_UNSIGNED_INT,
+                                      (const void *const *)offsets.data(), (GLsizei)tiles.size(), baseVertices.data());
+        DrawCalls = 1;
+    }
+}
+
+void TerrainGrid::drawVertexID(const std::vector<unsigned int> &tiles, StreamBuffer &stream)
+{
+    tileOrigins.clear();
+    for (unsigned int tile : tiles)
+        tileOrigins.push_back(glm::vec2((float)((tile / tilesZ) * tileSize), (float)((tile % tilesZ) * tileSize)));
+    DrawCalls = 0;
+    const GLintptr offset = stream.write(tileOrigins.data(), tileOrigins.size() * sizeof(glm::vec2), sizeof(glm::vec2));
+    if (offset < 0)
+        return;
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void *)offset);
+
+    if (!tiles.empty())
+    {
+        // every row: 2 * (tileSize + 1) vertices plus the two repeated ones
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, (GLsizei)(tileSize * (2 * tileSize + 4)), (GLsizei)tiles.size());
+        DrawCalls = 1;
+    }
+}
+
+#endif
@@ -0,0 +1,335 @@
+#ifndef TERRAIN_HEIGHTMAP_H
+#define TERRAIN_HEIGHTMAP_H
+
+/*
+* Binary height map cache
+- Decoding the PNG every launch costs more than the rest of the startup
+- First launch: decode the source once, write "<source>.hmap" next to it
+- Later launches: mmap the .hmap file, the samples are used in place (zero copy)
+
+* .hmap file
+- 4096 byte header -> samples start page aligned
+    magic "HMAP", version, width, height, sample format,
+    source size, source modification time, source hash (FNV-1a 64)
+- width * height samples, row by row, one channel, tightly packed:
+    SAMPLE_U8   8-bit images
+    SAMPLE_U16  16-bit PNG / PGM, raw .r16
+    SAMPLE_F32  .hdr images, raw .r32, text sources (see terrain_ascii.h)
+
+* Sources
+- Images are decoded as one channel (grayscale), at their own bit depth
+  -> 16-bit maps keep all 65536 levels, no 4 channel RGBA buffer
+- .r16 / .r32: headerless little endian uint16 / float samples of a square map
+- Samples stay in their format, range() gives the values for the height scale
+
+* Stale cache
+- size + modification time of the source match -> valid without reading the source
+- otherwise the source is hashed: same hash (file copied / touched) -> still valid,
+  the new modification time is written into the header -> the next launch skips the hash
+- anything else (missing, other version, corrupt) -> decode the source again
+*/
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <sys/stat.h>
+#include "terrain_ascii.h"
+// stbi_load: include stb_image.h before this header, once with STB_IMAGE_IMPLEMENTATION
+
+// Defines the sample types of a height map, value stored in the .hmap header
+enum Sample_Format {
+    SAMPLE_U8 = 1,
+    SAMPLE_U16 = 2,
+    SAMPLE_F32 = 4
+};
+
+class HeightMap
+{
+public:
+    int Width = 0;
+    int Height = 0;
+    Sample_Format Format = SAMPLE_U8;
+    // true if the samples come from a valid .hmap file
+    bool FromCache = false;
+
+    HeightMap() {}
+    ~HeightMap() { close(); }
+    HeightMap(const HeightMap &) = delete;
+    HeightMap &operator=(const HeightMap &) = delete;
+
+    // open a height map (.png / .pgm / .hdr / ... through stb_image, raw .r16 / .r32,
+    // .txt / .asc / .xyz text, see terrain_ascii.h)
+    // through its .hmap cache, the cache is (re)written when missing or stale
+    bool load(const std::string &sourcePath)
+    {
+        close();
+        const std::string cachePath = sourcePath + ".hmap";
+        SourceInfo source;
+        if (!sourceInfo(sourcePath, source, false))
+        {
+            std::cout << "ERROR::HEIGHTMAP::SOURCE_NOT_FOUND " << sourcePath << std::endl;
+            return false;
+        }
+        if (openCache(cachePath, sourcePath, source))
+        {
+            FromCache = true;
+            return true;
+        }
+        if (!decode(sourcePath))
+            return false;
+        sourceInfo(sourcePath, source, true);
+        if (!writeCache(cachePath, source))
+            std::cout << "WARNING::HEIGHTMAP::CACHE_NOT_WRITTEN " << cachePath << std::endl;
+        return true;
+    }
+
+    // samples, Width * Height, row by row
+    const void *data() const { return file.data ? file.data + HEADER_SIZE : (const char *)decoded.data(); }
+    size_t sampleBytes() const { return (size_t)Width * Height * Format; }
+
+    // smallest and largest sample value
+    void range(float &low, float &high) const
+    {
+        if (Format == SAMPLE_U8)
+            sampleRange((const unsigned char *)data(), low, high);
+        else if (Format == SAMPLE_U16)
+            sampleRange((const unsigned short *)data(), low, high);
+        else
+            sampleRange((const float *)data(), low, high);
+    }
+
+    void close()
+    {
+        file.close();
+        decoded = std::vector<unsigned char>();
+        FromCache = false;
+    }
+
+private:
+    static const size_t HEADER_SIZE = 4096;
+    static const uint32_t VERSION = 2;
+
+    struct SourceInfo
+    {
+        uint64_t size = 0;
+        int64_t modified = 0;
+        uint64_t hash = 0;
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        int32_t width, height;
+        uint32_t format;
+        uint32_t reserved;
+        uint64_t sourceSize;
+        int64_t sourceModified;
+        uint64_t sourceHash;
+    };
+
+    MappedFile file;
+    std::vector<unsigned char> decoded;
+
+    static bool sourceInfo(const std::string &path, SourceInfo &info, bool withHash)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        info.size = (uint64_t)st.st_size;
+        info.modified = (int64_t)st.st_mtime;
+        if (withHash)
+            info.hash = hashFile(path);
+        return true;
+    }
+
+    // FNV-1a over the whole file
+    static uint64_t hashFile(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> buffer(1 << 16);
+        uint64_t hash = 14695981039346656037ull;
+        while (file)
+        {
+            file.read(buffer.data(), buffer.size());
+            for (std::streamsize i = 0; i < file.gcount(); i++)
+            {
+                hash ^= (unsigned char)buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    template <typename Sample>
+    void sampleRange(const Sample *samples, float &low, float &high) const
+    {
+        const size_t count = (size_t)Width * Height;
+        Sample lo = count ? samples[0] : Sample(), hi = lo;
+        for (size_t i = 1; i < count; i++)
+        {
+            lo = std::min(lo, samples[i]);
+            hi = std::max(hi, samples[i]);
+        }
+        low = (float)lo;
+        high = (float)hi;
+    }
+
+    bool openCache(const std::string &cachePath, const std::string &sourcePath, const SourceInfo &source)
+    {
+        std::vector<unsigned char> headerBytes(sizeof(Header));
+        {
+            std::ifstream stream(cachePath, std::ios::binary);
+            if (!stream.read((char *)headerBytes.data(), sizeof(Header)))
+                return false;
+        }
+        Header header;
+        std::memcpy(&header, headerBytes.data(), sizeof(Header));
+        if (std::memcmp(header.magic, "HMAP", 4) != 0 || header.version != VERSION || header.width <= 0 || header.height <= 0
+            || (header.format != SAMPLE_U8 && header.format != SAMPLE_U16 && header.format != SAMPLE_F32))
+            return false;
+        if (header.sourceSize != source.size)
+            return false;
+        if (header.sourceModified != source.modified)
+        {
+            if (header.sourceHash != hashFile(sourcePath))
+                return false;
+            // same contents (checkout / touch): remember the new time, best effort
+            std::fstream stream(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+            stream.seekp(offsetof(Header, sourceModified));
+            stream.write((const char *)&source.modified, sizeof(source.modified));
+        }
+
+        Width = header.width;
+        Height = header.height;
+        Format = (Sample_Format)header.format;
+        const size_t size = HEADER_SIZE + sampleBytes();
+        if (!file.open(cachePath) || file.size != size)
+        {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    bool writeCache(const std::string &cachePath, const SourceInfo &source) const
+    {
+        Header header = {};
+        std::memcpy(header.magic, "HMAP", 4);
+        header.version = VERSION;
+        header.width = Width;
+        header.height = Height;
+        header.format = Format;
+        header.sourceSize = source.size;
+        header.sourceModified = source.modified;
+        header.sourceHash = source.hash;
+        std::vector<unsigned char> headerBytes(HEADER_SIZE, 0);
+        std::memcpy(headerBytes.data(), &header, sizeof(Header));
+
+        // write to a temporary file first -> a crash never leaves a half written cache
+        const std::string tempPath = cachePath + ".tmp";
+        {
+            std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+            stream.write((const char *)headerBytes.data(), headerBytes.size());
+            stream.write((const char *)decoded.data(), decoded.size());
+            if (!stream)
+                return false;
+        }
+        return std::rename(tempPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+    bool decode(const std::string &path)
+    {
+        const std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+        if (extension == ".txt" || extension == ".asc" || extension == ".xyz")
+            return decodeText(path);
+        if (extension == ".r16")
+            return decodeRaw(path, SAMPLE_U16);
+        if (extension == ".r32")
+            return decodeRaw(path, SAMPLE_F32);
+
+        // one channel requested -> stb_image converts while decoding, no RGBA copy
+        // (grayscale: the conversion keeps the value exactly)
+        int width, height, nChannels;
+        void *data;
+        Sample_Format format;
+        if (stbi_is_hdr(path.c_str()))
+        {
+            data = stbi_loadf(path.c_str(), &width, &height, &nChannels, 1);
+            format = SAMPLE_F32;
+        }
+        else if (stbi_is_16_bit(path.c_str()))
+        {
+            // 16-bit PNG, PGM / PPM with maxval > 255
+            data = stbi_load_16(path.c_str(), &width, &height, &nChannels, 1);
+            format = SAMPLE_U16;
+        }
+        else
+        {
+            data = stbi_load(path.c_str(), &width, &height, &nChannels, 1);
+            format = SAMPLE_U8;
+        }
+        if (!data)
+        {
+            std::cout << "Failed to load texture" << std::endl;
+            return false;
+        }
+        Width = width;
+        Height = height;
+        Format = format;
+        decoded.resize(sampleBytes());
+        std::memcpy(decoded.data(), data, decoded.size());
+        stbi_image_free(data);
+        return true;
+    }
+
+    // headerless little endian samples, square (width = height = sqrt(samples))
+    bool decodeRaw(const std::string &path, Sample_Format format)
+    {
+        MappedFile raw;
+        if (!raw.open(path))
+        {
+            std::cout << "ERROR::HEIGHTMAP::RAW_NOT_READ " << path << std::endl;
+            return false;
+        }
+        const size_t samples = raw.size / format;
+        size_t side = (size_t)std::sqrt((double)samples);
+        while (side * side > samples)
+            side--;
+        while ((side + 1) * (side + 1) <= samples)
+            side++;
+        if (side < 2 || side * side * format != raw.size)
+        {
+            std::cout << "ERROR::HEIGHTMAP::RAW_NOT_SQUARE " << path << " (" << raw.size << " bytes)" << std::endl;
+            return false;
+        }
+        Width = Height = (int)side;
+        Format = format;
+        decoded.resize(raw.size);
+        std::memcpy(decoded.data(), raw.data, raw.size);
+        return true;
+    }
+
+    // text height fields, parsed in parallel
+    bool decodeText(const std::string &path)
+    {
+        AsciiHeightLoader loader;
+        if (!loader.load(path))
+            return false;
+        Width = loader.Width;
+        Height = loader.Height;
+        Format = SAMPLE_F32;
+        decoded.resize(loader.Heights.size() * sizeof(float));
+        std::memcpy(decoded.data(), loader.Heights.data(), decoded.size());
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,335 @@
+/*
+
+* Terrain CPU kernel benchmarks
+- Every CPU step height_map.cpp runs before (and between) frames, on synthetic
+  square height maps of 256^2 up to the max size (x4 per step, default 16384^2):
+    decode      16-bit PGM through stb_image (one channel)
+    hmap cache  open the .hmap cache + read every sample (see terrain_heightmap.h)
+    vertices    TerrainMeshBuilder vertices (padded to tiles, no indices)
+    indices     TerrainMeshBuilder::buildIndices (banded strips)
+    rtin errors TerrainRTIN error map
+    tile bounds TerrainTiles bounding boxes
+    cull        TerrainTiles::cull, one frustum (x 1000 per run)
+- The tree computes no normals (shading uses the height only), so there is no normal kernel
+- Reported per kernel and size:
+    best time of the repetitions, throughput,
+    allocations + allocated bytes of one run (global operator new and stb_image are counted),
+    peak RSS above the RSS before the run (VmHWM, reset through /proc/self/clear_refs)
+- A size that does not fit in memory is reported and skipped
+
+usage: terrain_kernels_bench [max size] [repetitions] [kernel name]
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <sys/resource.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+static void *countedMalloc(size_t size);
+static void *countedRealloc(void *p, size_t size);
+static void countedFree(void *p);
+#define STBI_MALLOC(size) countedMalloc(size)
+#define STBI_REALLOC(p, size) countedRealloc(p, size)
+#define STBI_FREE(p) countedFree(p)
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "camera.h"
+#include "terrain_heightmap.h"
+#include "terrain_mesh.h"
+#include "terrain_rtin.h"
+#include "terrain_tiles.h"
+
+// allocations of the process, all threads: operator new and stb_image
+static std::atomic<unsigned long long> allocations(0);
+static std::atomic<unsigned long long> allocatedBytes(0);
+// results nobody reads otherwise, keeps the optimizer from removing the work
+static volatile float sink;
+
+static void *countedMalloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+static void *countedRealloc(void *p, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::realloc(p, size);
+}
+// operator delete and stb_image free through here; GCC inlines it into the replaced
+// operator delete and then takes std::free of operator new memory for a mismatch,
+// but the replaced operator new is countedMalloc -> the pairing is right
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static void countedFree(void *p)
+{
+    std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic pop
+#endif
+
+void *operator new(size_t size)
+{
+    if (void *p = countedMalloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { countedFree(p); }
+void operator delete(void *p, size_t) noexcept { countedFree(p); }
+void operator delete[](void *p) noexcept { countedFree(p); }
+void operator delete[](void *p, size_t) noexcept { countedFree(p); }
+
+// VmHWM / VmRSS of /proc/self/status in KB, ru_maxrss when not available
+static long statusKB(const char *field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    const size_t length = std::strlen(field);
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, length, field) == 0)
+            return std::atol(line.c_str() + length + 1);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// peak RSS := current RSS (Linux >= 4.0)
+static void resetPeakRSS()
+{
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+struct KernelResult
+{
+    double bestMs = 0.0;
+    unsigned long long allocations = 0;
+    unsigned long long bytes = 0;
+    long peakKB = 0;
+    bool outOfMemory = false;
+};
+
+// best of repetitions, allocations and peak RSS of the first run
+static KernelResult measure(int repetitions, const std::function<void()> &setup, const std::function<void()> &run)
+{
+    KernelResult result;
+    result.bestMs = 1e30;
+    try
+    {
+        for (int r = 0; r < repetitions; r++)
+        {
+            setup();
+            resetPeakRSS();
+            const long rssBefore = statusKB("VmRSS:");
+            const unsigned long long allocationsBefore = allocations.load(), bytesBefore = allocatedBytes.load();
+            auto start = std::chrono::steady_clock::now();
+            run();
+            auto end = std::chrono::steady_clock::now();
+            result.bestMs = std::min(result.bestMs, std::chrono::duration<double>(end - start).count() * 1000.0);
+            if (r == 0)
+            {
+                result.allocations = allocations.load() - allocationsBefore;
+                result.bytes = allocatedBytes.load() - bytesBefore;
+                result.peakKB = std::max(0L, statusKB("VmHWM:") - rssBefore);
+            }
+        }
+    }
+    catch (const std::bad_alloc &)
+    {
+        result.outOfMemory = true;
+    }
+    return result;
+}
+
+static void printResult(const char *kernel, int size, const KernelResult &result, double work, const char *unit)
+{
+    std::cout << std::left << std::setw(13) << kernel << std::right << std::setw(7) << size;
+    if (result.outOfMemory)
+    {
+        std::cout << "  out of memory" << std::endl;
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(2) << std::setw(11) << result.bestMs
+              << std::setw(10) << work / (result.bestMs / 1000.0) << " " << std::left << std::setw(9) << unit << std::right
+              << std::setw(9) << result.allocations
+              << std::setw(11) << result.bytes / (1024.0 * 1024.0)
+              << std::setw(11) << result.peakKB / 1024.0 << std::endl;
+}
+
+// smooth hills + some ridges, deterministic
+static std::vector<unsigned short> syntheticHeights(int size)
+{
+    std::vector<unsigned short> heights((size_t)size * size);
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            const float x = (float)i / size * 6.2831853f, z = (float)j / size * 6.2831853f;
+            float h = 0.5f + 0.25f * std::sin(x * 2.0f) * std::cos(z * 3.0f)
+                    + 0.15f * std::sin(x * 7.0f + z * 5.0f) + 0.1f * std::fabs(std::sin(x * 23.0f - z * 17.0f));
+            heights[(size_t)i * size + j] = (unsigned short)(std::min(std::max(h, 0.0f), 1.0f) * 65535.0f);
+        }
+    }
+    return heights;
+}
+
+static bool writePGM(const std::string &path, const std::vector<unsigned short> &heights, int size)
+{
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    stream << "P5\n" << size << " " << size << "\n65535\n";
+    std::vector<unsigned char> row((size_t)size * 2);
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            const unsigned short h = heights[(size_t)i * size + j];
+            row[j * 2] = (unsigned char)(h >> 8); // PGM samples are big endian
+            row[j * 2 + 1] = (unsigned char)(h & 0xff);
+        }
+        stream.write((const char *)row.data(), row.size());
+    }
+    return (bool)stream;
+}
+
+int main(int argc, char *argv[])
+{
+    const int maxSize = argc > 1 ? std::atoi(argv[1]) : 16384;
+    const int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 3;
+    const std::string only = argc > 3 ? argv[3] : "";
+    const auto enabled = [&only](const char *kernel) { return only.empty() || only == kernel; };
+
+    std::cout << std::left << std::setw(13) << "kernel" << std::right << std::setw(7) << "size"
+              << std::setw(11) << "best ms" << std::setw(20) << "throughput"
+              << std::setw(9) << "allocs" << std::setw(11) << "alloc MB" << std::setw(11) << "peak MB" << std::endl;
+    for (int size = 256; size <= maxSize; size *= 4)
+    {
+        const double samples = (double)size * size;
+        std::vector<unsigned short> heights;
+        try
+        {
+            heights = syntheticHeights(size);
+        }
+        catch (const std::bad_alloc &)
+        {
+            std::cout << "size " << size << ": out of memory" << std::endl;
+            break;
+        }
+        const std::string pgmPath = "./terrain_kernels_bench_" + std::to_string(size) + ".pgm";
+        const double fileMB = (samples * 2.0) / (1024.0 * 1024.0);
+
+        if (enabled("decode") || enabled("hmap"))
+        {
+            writePGM(pgmPath, heights, size);
+            std::remove((pgmPath + ".hmap").c_str());
+        }
+        if (enabled("decode"))
+        {
+            KernelResult result = measure(repetitions, [] {}, [&] {
+                int width, height, nChannels;
+                unsigned short *data = stbi_load_16(pgmPath.c_str(), &width, &height, &nChannels, 1);
+                if (!data) // only fails on allocation here
+                    throw std::bad_alloc();
+                stbi_image_free(data);
+            });
+            printResult("decode", size, result, fileMB, "MB/s");
+        }
+        if (enabled("hmap"))
+        {
+            // first load decodes and writes the cache
+            {
+                HeightMap heightMap;
+                heightMap.load(pgmPath);
+            }
+            KernelResult result = measure(repetitions, [] {}, [&] {
+                HeightMap heightMap;
+                float low, high;
+                heightMap.load(pgmPath);
+                heightMap.range(low, high);
+                sink = low + high;
+            });
+            printResult("hmap cache", size, result, fileMB, "MB/s");
+        }
+        std::remove(pgmPath.c_str());
+        std::remove((pgmPath + ".hmap").c_str());
+
+        // mesh as height_map.cpp builds it
+        TerrainMeshBuilder mesh(NULL, 64);
+        mesh.padToTiles = true;
+        mesh.stripWidth = 15;
+        mesh.withIndices = false;
+        mesh.fitHeights(0.0f, 65535.0f);
+        if (enabled("vertices") || enabled("indices") || enabled("tiles") || enabled("cull"))
+        {
+            KernelResult result = measure(repetitions, [&] { mesh.vertices = std::vector<float>(); }, [&] {
+                mesh.build(heights.data(), size, size, 1);
+            });
+            if (enabled("vertices") || result.outOfMemory)
+                printResult("vertices", size, result, samples / 1e6, "M/s");
+            if (result.outOfMemory)
+                continue;
+        }
+        if (enabled("indices"))
+        {
+            KernelResult result = measure(repetitions, [&] { mesh.indices = std::vector<unsigned int>(); }, [&] {
+                mesh.buildIndices();
+            });
+            printResult("indices", size, result, mesh.indices.size() / 1e6, "M/s");
+            mesh.indices = std::vector<unsigned int>();
+        }
+        if (enabled("rtin"))
+        {
+            TerrainRTIN rtin;
+            rtin.yScale = mesh.yScale;
+            rtin.yShift = mesh.yShift;
+            KernelResult result = measure(repetitions, [] {}, [&] {
+                rtin.build(heights.data(), size, size, 1);
+            });
+            printResult("rtin errors", size, result, samples / 1e6, "M/s");
+        }
+        if (enabled("tiles") || enabled("cull"))
+        {
+            std::unique_ptr<TerrainTiles> tiles;
+            KernelResult result = measure(repetitions, [&] { tiles.reset(); }, [&] {
+                tiles.reset(new TerrainTiles(mesh.vertices, mesh.width(), mesh.height(), 64));
+            });
+            if (enabled("tiles"))
+                printResult("tile bounds", size, result, samples / 1e6, "M/s");
+            if (enabled("cull") && tiles)
+            {
+                // start pose of height_map.cpp
+                Camera camera(glm::vec3(67.0f, 627.5f, 169.9f), glm::vec3(0.0f, 1.0f, 0.0f), -128.1f, -42.4f);
+                const glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 800.0f / 600.0f, 0.1f, 100000.0f);
+                const Frustum frustum(projection * camera.GetViewMatrix());
+                const int culls = 1000;
+                KernelResult cull = measure(repetitions, [] {}, [&] {
+                    for (int c = 0; c < culls; c++)
+                        tiles->cull(frustum);
+                });
+                printResult("cull", size, cull, (double)tiles->NumTiles * culls / 1e6, "Mtiles/s");
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,383 @@
+#ifndef TERRAIN_LOD_H
+#define TERRAIN_LOD_H
+
+/*
+* Geomipmapping
+- Every tile (tileSize x tileSize quads) can be drawn at several levels of detail
+    - level l uses every (1 << l)-th vertex: stride 1, 2, 4, 8 ... tileSize / 2
+    - the vertex buffer is the full resolution grid, only the indices differ
+- Index patterns use tile local offsets (i * gridWidth + j)
+  -> one pattern per level serves every tile, glDrawElementsBaseVertex adds
+     the first vertex of the tile
+
+* Level selection
+- geometric error e(l): largest height difference between the full resolution
+  tile and its level l triangulation, computed once per tile and level
+- screen space error = e(l) * K / distance, K = viewport height / (2 * tan(fov / 2))
+- pick the coarsest level whose screen space error is below PixelError
+- too many triangles? -> raise the error threshold until the visible tiles fit
+  into TriangleBudget, independent of the height map resolution
+
+* Cracks
+- Neighbouring levels differ by at most one (coarse tiles next to fine tiles are refined)
+- A tile next to a coarser neighbour uses a stitched variant of its pattern:
+  odd vertices on that edge are snapped onto an even neighbour vertex
+  -> the edge matches the neighbour's edge exactly, snapped triangles collapse
+- 4 edges -> 16 variants per level, the neighbour mask selects one
+*/
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include "shaders.h"
+#include "job_system.h"
+
+// edges of a tile, bits of the neighbour mask
+enum Tile_Edge {
+    EDGE_X_NEG = 1, // row 0
+    EDGE_X_POS = 2, // last row
+    EDGE_Z_NEG = 4, // column 0
+    EDGE_Z_POS = 8  // last column
+};
+
+const int NUM_EDGE_MASKS = 16;
+
+// debug view colors, one per level
+const glm::vec3 LOD_COLORS[] = {
+    glm::vec3(1.0f, 0.2f, 0.2f),
+    glm::vec3(1.0f, 0.6f, 0.1f),
+    glm::vec3(1.0f, 1.0f, 0.2f),
+    glm::vec3(0.2f, 1.0f, 0.2f),
+    glm::vec3(0.2f, 1.0f, 1.0f),
+    glm::vec3(0.2f, 0.4f, 1.0f),
+    glm::vec3(0.7f, 0.3f, 1.0f),
+    glm::vec3(1.0f, 0.3f, 0.8f)
+};
+
+class TerrainLOD
+{
+public:
+    // selection parameters
+    float PixelError = 2.0f;
+    unsigned int TriangleBudget = 500000;
+
+    // stats of the last select()
+    unsigned int Triangles = 0;
+    unsigned int DrawCalls = 0;
+    float ErrorThreshold = 0.0f;
+    unsigned int TilesPerLevel[8] = {};
+
+    // vertices: full resolution grid, 3 floats per vertex, row by row
+    // width, height: grid size, (size - 1) must be a multiple of tileSize (a power of two)
+    TerrainLOD(const std::vector<float> &vertices, int width, int height, unsigned int tileSize);
+
+    // choose a level for every tile, visibleTiles as returned by TerrainTiles::cull
+    void select(const glm::vec3 &cameraPos, float fovy, float viewportHeight,
+                const std::vector<unsigned int> &visibleTiles);
+    // draw the selected tiles, terrain VAO must be bound
+    void draw(bool multiDraw);
+    // draw tile by tile, tinting every tile with its level color
+    void drawDebug(Shader &shader);
+
+    unsigned int numLevels() const { return levels; }
+
+private:
+    int gridWidth, gridHeight;
+    unsigned int tileSize, tilesX, tilesZ, levels;
+    GLuint ebo;
+
+    // pattern (level, edge mask) -> range in ebo
+    std::vector<GLsizei> patternCount;
+    std::vector<size_t> patternFirst;
+
+    // per tile: bounding box, geometric error per level, selected level
+    std::vector<glm::vec3> tileMin, tileMax;
+    std::vector<float> tileError;
+    std::vector<unsigned char> tileLevel;
+    std::vector<unsigned int> visible;
+
+    // glMultiDrawElementsBaseVertex arguments
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+    std::vector<GLint> baseVertices;
+
+    void buildPatterns();
+    void computeErrors(const std::vector<float> &vertices);
+    void computeTileRows(const std::vector<float> &vertices, unsigned int txBegin, unsigned int txEnd);
+    void chooseLevels(const glm::vec3 &cameraPos, float K, float threshold);
+    void restrictNeighbours();
+    unsigned int edgeMask(unsigned int tile) const;
+};
+
+TerrainLOD::TerrainLOD(const std::vector<float> &vertices, int width, int height, unsigned int tileSize)
+    : gridWidth(width), gridHeight(height), tileSize(tileSize)
+{
+    tilesX = (height - 1) / tileSize;
+    tilesZ = (width - 1) / tileSize;
+    // strides 1 .. tileSize / 2, at least 2 x 2 quads per tile so edges can be stitched
+    levels = 0;
+    while ((1u << (levels + 1)) <= tileSize && levels < 8)
+        levels++;
+
+    buildPatterns();
+    computeErrors(vertices);
+    tileLevel.assign(tilesX * tilesZ, 0);
+}
+
+void TerrainLOD::buildPatterns()
+{
+    std::vector<unsigned int> indices;
+    patternCount.resize(levels * NUM_EDGE_MASKS);
+    patternFirst.resize(levels * NUM_EDGE_MASKS);
+    for (unsigned int level = 0; level < levels; level++)
+    {
+        const unsigned int stride = 1u << level;
+        const int n = tileSize / stride;
+        for (unsigned int mask = 0; mask < NUM_EDGE_MASKS; mask++)
+        {
+            // odd vertex on a stitched edge -> previous even vertex, the last one -> the corner
+            // (snapping both ends away from the far corner would leave a T-junction there)
+            auto snap = [n](int k) { return (k & 1) ? (k == n - 1 ? n : k - 1) : k; };
+            // vertex (i, j) in level units -> tile local index
+            auto vertex = [&](int i, int j) -> unsigned int
+            {
+                if (((mask & EDGE_X_NEG) && i == 0) || ((mask & EDGE_X_POS) && i == n))
+                    j = snap(j);
+                if (((mask & EDGE_Z_NEG) && j == 0) || ((mask & EDGE_Z_POS) && j == n))
+                    i = snap(i);
+                return (unsigned int)(i * stride * gridWidth + j * stride);
+            };
+            auto triangle = [&](unsigned int a, unsigned int b, unsigned int c)
+            {
+                // collapsed by snapping (two corners merged, or all three on one line) -> skip
+                long long ai = a / gridWidth, aj = a % gridWidth;
+                long long bi = b / gridWidth, bj = b % gridWidth;
+                long long ci = c / gridWidth, cj = c % gridWidth;
+                if ((bi - ai) * (cj - aj) - (ci - ai) * (bj - aj) == 0)
+                    return;
+                indices.push_back(a);
+                indices.push_back(b);
+                indices.push_back(c);
+            };
+
+            patternFirst[level * NUM_EDGE_MASKS + mask] = indices.size();
+            for (int i = 0; i < n; i++)
+            {
+                for (int j = 0; j < n; j++)
+                {
+                    // same diagonal as the row strips: (i+1, j) - (i, j+1)
+                    unsigned int v00 = vertex(i, j), v01 = vertex(i, j + 1);
+                    unsigned int v10 = vertex(i + 1, j), v11 = vertex(i + 1, j + 1);
+                    triangle(v00, v10, v01);
+                    triangle(v01, v10, v11);
+                }
+            }
+            patternCount[level * NUM_EDGE_MASKS + mask] = (GLsizei)(indices.size() - patternFirst[level * NUM_EDGE_MASKS + mask]);
+        }
+    }
+
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 indices.size() * sizeof(unsigned int), // size of indices buffer
+                 indices.data(),                        // pointer to first element
+                 GL_STATIC_DRAW);
+}
+
+void TerrainLOD::computeErrors(const std::vector<float> &vertices)
+{
+    const unsigned int numTiles = tilesX * tilesZ;
+    tileMin.resize(numTiles);
+    tileMax.resize(numTiles);
+    tileError.assign(numTiles * levels, 0.0f);
+
+    // tiles are independent -> bands of tile rows as jobs (see job_system.h)
+    JobSystem::shared().parallelFor(0, tilesX, 1, [&](size_t txBegin, size_t txEnd) {
+        computeTileRows(vertices, (unsigned int)txBegin, (unsigned int)txEnd);
+    });
+}
+
+void TerrainLOD::computeTileRows(const std::vector<float> &vertices, unsigned int txBegin, unsigned int txEnd)
+{
+    auto heightAt = [&](size_t i, size_t j) { return vertices[(i * gridWidth + j) * 3 + 1]; };
+    for (unsigned int tx = txBegin; tx < txEnd; tx++)
+    {
+        for (unsigned int tz = 0; tz < tilesZ; tz++)
+        {
+            const unsigned int tile = tx * tilesZ + tz;
+            const size_t i0 = tx * tileSize, j0 = tz * tileSize;
+            float lo = FLT_MAX, hi = -FLT_MAX;
+            for (size_t i = i0; i <= i0 + tileSize; i++)
+            {
+                for (size_t j = j0; j <= j0 + tileSize; j++)
+                {
+                    lo = std::min(lo, heightAt(i, j));
+                    hi = std::max(hi, heightAt(i, j));
+                }
+            }
+            const float *first = &vertices[(i0 * gridWidth + j0) * 3];
+            const float *last = &vertices[((i0 + tileSize) * gridWidth + j0 + tileSize) * 3];
+            tileMin[tile] = glm::vec3(first[0], lo, first[2]);
+            tileMax[tile] = glm::vec3(last[0], hi, last[2]);
+
+            // level 0 is exact, coarser levels: distance of every vertex to the coarse triangles
+            for (unsigned int level = 1; level < levels; level++)
+            {
+                const size_t stride = (size_t)1 << level;
+                float error = tileError[tile * levels + level - 1];
+                for (size_t i = 0; i <= tileSize; i++)
+                {
+                    for (size_t j = 0; j <= tileSize; j++)
+                    {
+                        const size_t ci = std::min(i / stride * stride, tileSize - stride);
+                        const size_t cj = std::min(j / stride * stride, tileSize - stride);
+                        const float fi = (float)(i - ci) / stride, fj = (float)(j - cj) / stride;
+                        const float h00 = heightAt(i0 + ci, j0 + cj), h01 = heightAt(i0 + ci, j0 + cj + stride);
+                        const float h10 = heightAt(i0 + ci + stride, j0 + cj), h11 = heightAt(i0 + ci + stride, j0 + cj + stride);
+                        // triangle (00, 10, 01) or (01, 10, 11), split along the 10-01 diagonal
+                        float h = fi + fj <= 1.0f
+                                      ? h00 + fi * (h10 - h00) + fj * (h01 - h00)
+                                      : h11 + (1.0f - fi) * (h01 - h11) + (1.0f - fj) * (h10 - h11);
+                        error = std::max(error, std::fabs(h - heightAt(i0 + i, j0 + j)));
+                    }
+                }
+                // never smaller than the finer level -> error grows monotonically with the level
+                tileError[tile * levels + level] = error;
+            }
+        }
+    }
+}
+
+void TerrainLOD::select(const glm::vec3 &cameraPos, float fovy, float viewportHeight,
+                        const std::vector<unsigned int> &visibleTiles)
+{
+    const float K = viewportHeight / (2.0f * std::tan(fovy / 2.0f));
+    visible = visibleTiles;
+
+    // raise the threshold until the visible tiles fit into the budget
+    ErrorThreshold = PixelError;
+    for (int attempt = 0; attempt < 32; attempt++)
+    {
+        chooseLevels(cameraPos, K, ErrorThreshold);
+        restrictNeighbours();
+
+        Triangles = 0;
+        for (unsigned int tile : visible)
+            Triangles += patternCount[tileLevel[tile] * NUM_EDGE_MASKS + edgeMask(tile)] / 3;
+        if (Triangles <= TriangleBudget)
+            break;
+        ErrorThreshold *= 1.5f;
+    }
+
+    std::fill(TilesPerLevel, TilesPerLevel + 8, 0);
+    for (unsigned int tile : visible)
+        TilesPerLevel[tileLevel[tile]]++;
+}
+
+void TerrainLOD::chooseLevels(const glm::vec3 &cameraPos, float K, float threshold)
+{
+    // every tile, visible or not: hidden neighbours still decide the stitching
+    for (unsigned int tile = 0; tile < tilesX * tilesZ; tile++)
+    {
+        // distance to the closest point of the tile's bounding box
+        glm::vec3 closest = glm::max(tileMin[tile], glm::min(cameraPos, tileMax[tile]));
+        float distance = std::max(glm::length(closest - cameraPos), 1e-3f);
+        // largest allowed geometric error at this distance
+        float maxError = threshold * distance / K;
+        unsigned int level = 0;
+        while (level + 1 < levels && tileError[tile * levels + level + 1] <= maxError)
+            level++;
+        tileLevel[tile] = (unsigned char)level;
+    }
+}
+
+void TerrainLOD::restrictNeighbours()
+{
+    // refine coarse tiles until no neighbour is more than one level finer
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (unsigned int tx = 0; tx < tilesX; tx++)
+        {
+            for (unsigned int tz = 0; tz < tilesZ; tz++)
+            {
+                unsigned char &level = tileLevel[tx * tilesZ + tz];
+                unsigned char finest = level;
+                if (tx > 0)          finest = std::min(finest, tileLevel[(tx - 1) * tilesZ + tz]);
+                if (tx + 1 < tilesX) finest = std::min(finest, tileLevel[(tx + 1) * tilesZ + tz]);
+                if (tz > 0)          finest = std::min(finest, tileLevel[tx * tilesZ + tz - 1]);
+                if (tz + 1 < tilesZ) finest = std::min(finest, tileLevel[tx * tilesZ + tz + 1]);
+                if (level > finest + 1)
+                {
+                    level = finest + 1;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+unsigned int TerrainLOD::edgeMask(unsigned int tile) const
+{
+    const unsigned int tx = tile / tilesZ, tz = tile % tilesZ;
+    const unsigned char level = tileLevel[tile];
+    unsigned int mask = 0;
+    if (tx > 0 && tileLevel[tile - tilesZ] > level)          mask |= EDGE_X_NEG;
+    if (tx + 1 < tilesX && tileLevel[tile + tilesZ] > level) mask |= EDGE_X_POS;
+    if (tz > 0 && tileLevel[tile - 1] > level)               mask |= EDGE_Z_NEG;
+    if (tz + 1 < tilesZ && tileLevel[tile + 1] > level)      mask |= EDGE_Z_POS;
+    return mask;
+}
+
+void TerrainLOD::draw(bool multiDraw)
+{
+    counts.clear();
+    offsets.clear();
+    baseVertices.clear();
+    for (unsigned int tile : visible)
+    {
+        const unsigned int pattern = tileLevel[tile] * NUM_EDGE_MASKS + edgeMask(tile);
+        const unsigned int tx = tile / tilesZ, tz = tile % tilesZ;
+        counts.push_back(patternCount[pattern]);
+        offsets.push_back((void *)(sizeof(unsigned int) * patternFirst[pattern]));
+        baseVertices.push_back((GLint)(tx * tileSize * gridWidth + tz * tileSize));
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    DrawCalls = 0;
+    if (multiDraw)
+    {
+        if (!counts.empty())
+        {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+                                          (GLsizei)counts.size(), baseVertices.data());
+            DrawCalls = 1;
+        }
+        return;
+    }
+    for (size_t i = 0; i < counts.size(); i++)
+        glDrawElementsBaseVertex(GL_TRIANGLES, counts[i], GL_UNSIGNED_INT, offsets[i], baseVertices[i]);
+    DrawCalls = (unsigned int)counts.size();
+}
+
+void TerrainLOD::drawDebug(Shader &shader)
+{
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    DrawCalls = 0;
+    for (unsigned int tile : visible)
+    {
+        const unsigned int pattern = tileLevel[tile] * NUM_EDGE_MASKS + edgeMask(tile);
+        const unsigned int tx = tile / tilesZ, tz = tile % tilesZ;
+        shader.setVec3("lodColor", LOD_COLORS[tileLevel[tile] % 8]);
+        glDrawElementsBaseVertex(GL_TRIANGLES, patternCount[pattern], GL_UNSIGNED_INT,
+                                 (void *)(sizeof(unsigned int) * patternFirst[pattern]),
+                                 (GLint)(tx * tileSize * gridWidth + tz * tileSize));
+        DrawCalls++;
+    }
+}
+
+#endif
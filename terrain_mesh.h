@@ -0,0 +1,271 @@
+#ifndef TERRAIN_MESH_H
+#define TERRAIN_MESH_H
+
+/*
+* Terrain Mesh Builder
+- Turns a height map into the vertex / index arrays used by height_map.cpp
+- vertices: (x, y, z) for every texel, row by row
+- indices:  triangle strips, alternating between row i and i+1
+
+* Tiles
+- tileSize == 0: one strip per row, all strips form a single batch
+- tileSize  > 0: the grid is cut into tiles of tileSize x tileSize quads,
+                 indices are stored tile by tile (one strip per tile row),
+                 each tile is one batch -> it can be culled / drawn on its own
+- stripCounts: number of indices of every strip, in index buffer order
+- batchStrips: first strip of every batch, plus one past the last strip
+- padToTiles:  grow the grid to whole tiles (tileSize * n + 1 vertices per side)
+               by repeating the last row / column of the height map
+               -> every tile has the same size, LOD patterns can be shared
+- stripWidth:  quads per strip inside a tile, 0 -> one strip per tile row
+               narrower strips = column bands of the tile, strips of a band
+               follow each other -> the shared row is still in the post-transform
+               vertex cache when the next strip starts (see terrain_cache.h)
+- withIndices: false -> build() only fills the vertices, the strip indices can be
+               built later with buildIndices() (renderers that derive the
+               triangles from the grid never need them)
+
+* Parallel build
+- Both buffers are sized once up front -> no push_back, no reallocation
+- Rows are split into contiguous bands of ROW_GRAIN rows at least, run as jobs
+  of the job system (see job_system.h)
+- Each job writes the vertices of its rows AND the strips starting at its rows
+  -> every output element is written exactly once, no locking needed
+*/
+
+#include <vector>
+#include <algorithm>
+#include "job_system.h"
+
+class TerrainMeshBuilder
+{
+public:
+    // mesh data
+    std::vector<float> vertices;         // 3 floats per vertex, width * height vertices
+    std::vector<unsigned int> indices;   // triangle strips, stored batch by batch
+    std::vector<unsigned int> stripCounts;
+    std::vector<unsigned int> batchStrips;
+
+    // apply a scale+shift to the height data, y = sample * yScale - yShift
+    // (default: 8-bit samples -> [-16, 48), fitHeights() derives it from the data range)
+    float yScale = 64.0f / 256.0f;
+    float yShift = 16.0f;
+
+    // quads per tile side, 0 -> one strip per row, no tiles
+    unsigned int tileSize;
+    bool padToTiles = false;
+    unsigned int stripWidth = 0;
+    bool withIndices = true;
+    JobSystem *jobs;
+
+    // constructor, NULL -> the shared job system
+    TerrainMeshBuilder(JobSystem *jobs = NULL, unsigned int tiles = 0) : tileSize(tiles)
+    {
+        this->jobs = jobs ? jobs : &JobSystem::shared();
+    }
+
+    // map samples in [low, high] to heights in [bottom, top]
+    void fitHeights(float low, float high, float bottom = -16.0f, float top = 48.0f)
+    {
+        yScale = high > low ? (top - bottom) / (high - low) : 1.0f;
+        yShift = low * yScale - bottom;
+    }
+
+    // fill vertices and indices from height map samples (only channel 0 is read)
+    // Sample: unsigned char, unsigned short (16-bit) or float
+    template <typename Sample>
+    void build(const Sample *data, int width, int height, int nChannels)
+    {
+        mSourceWidth = mWidth = width;
+        mSourceHeight = mHeight = height;
+        if (tileSize && padToTiles)
+        {
+            mWidth = (width - 1 + tileSize - 1) / tileSize * tileSize + 1;
+            mHeight = (height - 1 + tileSize - 1) / tileSize * tileSize + 1;
+        }
+        buildLayout();
+        vertices.resize((size_t)mWidth * mHeight * 3);
+        indices.clear();
+        if (withIndices)
+            indices.resize(indexCount());
+        buildBands(data, nChannels);
+    }
+
+    // strip indices of the last build() made without them
+    void buildIndices()
+    {
+        if (indices.size() == indexCount())
+            return;
+        indices.resize(indexCount());
+        withIndices = true;
+        buildBands((const unsigned char *)nullptr, 0);
+    }
+
+    // grid size (after padding) and tile layout of the last build
+    int width() const { return mWidth; }
+    int height() const { return mHeight; }
+    unsigned int numStrips() const { return (unsigned int)stripCounts.size(); }
+    unsigned int numBatches() const { return batchStrips.empty() ? 0 : (unsigned int)batchStrips.size() - 1; }
+    unsigned int numTilesX() const { return tilesX; }
+    unsigned int numTilesZ() const { return tilesZ; }
+    // quads per tile side actually used (whole grid when not tiled)
+    unsigned int tileQuads() const { return tileSize ? tileSize : (unsigned int)std::max(mWidth, mHeight); }
+
+private:
+    int mWidth = 0;
+    int mHeight = 0;
+    int mSourceWidth = 0;
+    int mSourceHeight = 0;
+    // tiles along the rows (x) and along the columns (z)
+    unsigned int tilesX = 0;
+    unsigned int tilesZ = 0;
+
+    // indices of one row of strips across the whole grid (all tiles, all bands)
+    size_t rowIndices = 0;
+
+    // strip indices of the whole grid
+    size_t indexCount() const
+    {
+        return mHeight > 1 ? (size_t)(mHeight - 1) * rowIndices : 0;
+    }
+
+    // quads per strip inside a tile
+    unsigned int bandQuads() const
+    {
+        return stripWidth ? std::min(stripWidth, tileQuads()) : tileQuads();
+    }
+
+    // rows per job at least: a few thousand vertices, enough to hide the job overhead
+    static const int ROW_GRAIN = 16;
+
+    // run buildRows over bands of rows, in parallel on the job system
+    template <typename Sample>
+    void buildBands(const Sample *data, int nChannels)
+    {
+        jobs->parallelFor(0, (size_t)std::max(mHeight, 0), ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            buildRows(data, nChannels, (int)rowBegin, (int)rowEnd);
+        });
+    }
+
+    // strip and batch tables, cheap -> built serially before the parallel pass
+    void buildLayout()
+    {
+        const unsigned int quadRows = mHeight > 1 ? mHeight - 1 : 0;
+        const unsigned int quadCols = mWidth > 1 ? mWidth - 1 : 0;
+        const unsigned int T = tileQuads();
+        tilesX = (quadRows + T - 1) / T;
+        tilesZ = std::max(1u, (quadCols + T - 1) / T);
+
+        stripCounts.clear();
+        batchStrips.clear();
+        if (!tileSize)
+        {
+            // one batch, one strip per row
+            rowIndices = (size_t)mWidth * 2;
+            stripCounts.assign(quadRows, mWidth * 2);
+            batchStrips.push_back(0);
+            batchStrips.push_back(quadRows);
+            tilesX = quadRows ? 1 : 0;
+            return;
+        }
+        // every band of every tile adds one column to a row of strips
+        const unsigned int B = bandQuads();
+        rowIndices = 0;
+        for (unsigned int tz = 0; tz < tilesZ; tz++)
+        {
+            unsigned int cols = std::min(T, quadCols - tz * T);
+            rowIndices += (size_t)(cols + std::max(1u, (cols + B - 1) / B)) * 2;
+        }
+        stripCounts.reserve((size_t)quadRows * tilesZ * ((T + B - 1) / B));
+        for (unsigned int tx = 0; tx < tilesX; tx++)
+        {
+            unsigned int rows = std::min(T, quadRows - tx * T);
+            for (unsigned int tz = 0; tz < tilesZ; tz++)
+            {
+                unsigned int cols = std::min(T, quadCols - tz * T);
+                batchStrips.push_back((unsigned int)stripCounts.size());
+                // band by band, within a band row by row
+                for (unsigned int b0 = 0; b0 == 0 || b0 < cols; b0 += B)
+                    stripCounts.insert(stripCounts.end(), rows, (std::min(B, cols - b0) + 1) * 2);
+            }
+        }
+        batchStrips.push_back((unsigned int)stripCounts.size());
+    }
+
+    // vertices of rows [rowBegin, rowEnd) and the strips starting at those rows
+    // data == nullptr -> indices only, withIndices == false -> vertices only
+    template <typename Sample>
+    void buildRows(const Sample *data, int nChannels, int rowBegin, int rowEnd)
+    {
+        const int width = mWidth, height = mHeight;
+        const size_t T = tileQuads(), B = bandQuads();
+        for (int i = rowBegin; i < rowEnd; i++)
+        {
+            if (data)
+                buildVertexRow(data, nChannels, i);
+
+            // strip i connects row i and i+1, the last row starts no strip
+            if (!withIndices || i == height - 1)
+                continue;
+            if (!tileSize)
+            {
+                unsigned int *index = &indices[(size_t)i * width * 2];
+                for (int j = 0; j < width; j++)
+                {
+                    index[0] = j + width * i;
+                    index[1] = j + width * (i + 1);
+                    index += 2;
+                }
+                continue;
+            }
+
+            // tile row of this strip: all strips of earlier tile rows come first,
+            // then within the tile row tile by tile, band by band, each band strip by strip
+            const size_t tx = i / T, r = i % T;
+            const size_t rows = std::min(T, (size_t)(height - 1) - tx * T);
+            size_t offset = tx * T * rowIndices;
+            for (size_t tz = 0; tz < tilesZ; tz++)
+            {
+                const size_t c0 = tz * T;
+                const size_t c1 = std::min(c0 + T, (size_t)width - 1);
+                for (size_t b0 = c0; b0 == c0 || b0 < c1; b0 += B)
+                {
+                    const size_t b1 = std::min(b0 + B, c1);
+                    unsigned int *index = &indices[offset + r * (b1 - b0 + 1) * 2];
+                    for (size_t j = b0; j <= b1; j++)
+                    {
+                        index[0] = j + width * i;
+                        index[1] = j + width * (i + 1);
+                        index += 2;
+                    }
+                    offset += rows * (b1 - b0 + 1) * 2;
+                }
+            }
+        }
+    }
+
+    // vertices of row i
+    template <typename Sample>
+    void buildVertexRow(const Sample *data, int nChannels, int i)
+    {
+        const int width = mWidth;
+        const int sourceWidth = mSourceWidth, sourceHeight = mSourceHeight;
+        // padding rows / columns repeat the last one of the height map
+        float *vertex = &vertices[(size_t)i * width * 3];
+        const Sample *texel = data + (size_t)std::min(i, sourceHeight - 1) * sourceWidth * nChannels;
+        for (int j = 0; j < width; j++)
+        {
+            // raw height at coordinate, grayscale -> all channels are same
+            float y = (float)texel[0];
+            // centered on the height map, padding only grows towards +x / +z
+            vertex[0] = -(sourceHeight / 2.0f) + i;
+            vertex[1] = y * yScale - yShift;
+            vertex[2] = -(sourceWidth / 2.0f) + j;
+            vertex += 3;
+            if (j < sourceWidth - 1)
+                texel += nChannels;
+        }
+    }
+};
+
+#endif
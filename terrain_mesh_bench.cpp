@@ -0,0 +1,77 @@
+/*
+
+* Terrain mesh builder benchmark
+- Builds the height map mesh of height_map.cpp on job systems of 1..N threads
+- Reports rows/s and speed-up over the single threaded build
+- Checks every parallel result against the single threaded one
+
+usage: terrain_mesh_bench [height map path] [max threads] [repetitions]
+
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+#include "terrain_mesh.h"
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "./img/iceland_heightmap.png";
+    unsigned int maxThreads = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    int repetitions = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    int width, height, nChannels;
+    unsigned char *data = stbi_load(path, &width, &height, &nChannels, 0);
+    if (!data)
+    {
+        std::cout << "Failed to load texture" << std::endl;
+        return -1;
+    }
+    std::cout << path << ": " << width << " x " << height << ", " << nChannels << " channels" << std::endl;
+
+    // reference result: no workers, everything in this thread
+    JobSystem serial(1);
+    TerrainMeshBuilder reference(&serial);
+    reference.build(data, width, height, nChannels);
+
+    double baseRowsPerSec = 0.0;
+    std::cout << std::setw(8) << "threads" << std::setw(12) << "best ms" << std::setw(14) << "rows/s"
+              << std::setw(10) << "speedup" << std::endl;
+    for (unsigned int threads = 1; threads <= maxThreads; threads++)
+    {
+        // own pool of that many threads (see job_system.h)
+        JobSystem jobs(threads);
+        TerrainMeshBuilder mesh(&jobs);
+        double best = 1e30;
+        for (int r = 0; r < repetitions; r++)
+        {
+            // fresh buffers every run -> allocation + first touch are part of the cost, as at startup
+            mesh.vertices = std::vector<float>();
+            mesh.indices = std::vector<unsigned int>();
+            auto start = std::chrono::steady_clock::now();
+            mesh.build(data, width, height, nChannels);
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(end - start).count());
+        }
+        if (mesh.vertices != reference.vertices || mesh.indices != reference.indices)
+        {
+            std::cout << "ERROR::BENCH::MESH_MISMATCH with " << threads << " threads" << std::endl;
+            stbi_image_free(data);
+            return -1;
+        }
+
+        double rowsPerSec = height / best;
+        if (threads == 1)
+            baseRowsPerSec = rowsPerSec;
+        std::cout << std::setw(8) << threads
+                  << std::setw(12) << std::fixed << std::setprecision(2) << best * 1000.0
+                  << std::setw(14) << std::setprecision(0) << rowsPerSec
+                  << std::setw(9) << std::setprecision(2) << rowsPerSec / baseRowsPerSec << "x" << std::endl;
+    }
+
+    stbi_image_free(data);
+    return 0;
+}
@@ -0,0 +1,240 @@
+#ifndef TERRAIN_RTIN_H
+#define TERRAIN_RTIN_H
+
+/*
+* Right-Triangulated Irregular Network (RTIN)
+- Adaptive mesh: flat areas get few large triangles, rough areas many small ones
+- Grid of (2^k + 1) x (2^k + 1) vertices, split into two right triangles,
+  every right triangle splits at the middle of its hypotenuse into two halves
+  -> binary tree of triangles, all vertices on the grid
+
+* Error map (computed once)
+- errors[m]: height difference between the grid and the triangulation
+  if the triangles with hypotenuse midpoint m are NOT split
+- Walk the triangles from the smallest to the largest:
+    errors[m] = max(own interpolation error, errors of the child midpoints)
+  -> a vertex is never needed without the vertices of its parents, so any
+     threshold gives a mesh without T-junctions (no cracks)
+
+* Extraction (per threshold)
+- Split a triangle while its midpoint error is above maxError, else emit it
+- Cost grows with the output, not with the grid -> milliseconds
+- Output: vertices (x, y, z like TerrainMeshBuilder) and GL_TRIANGLES indices,
+  only the vertices used by the triangles
+- Clipped to the height map: triangles entirely in the padding are skipped, the corners
+  of triangles across the border are clamped onto it (triangles collapsing to a line
+  are dropped) -> no flat skirt beyond the map, counts are those of the drawn mesh
+
+* Based on the "Martini" mesher (mapbox, Vladimir Agafonkin)
+*/
+
+#include <glad/glad.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+class TerrainRTIN
+{
+public:
+    // mesh data of the last extract(), ready for glBufferData
+    std::vector<float> vertices;        // 3 floats per vertex
+    std::vector<unsigned int> indices;  // 3 indices per triangle
+
+    // apply a scale+shift to height map samples (same as TerrainMeshBuilder)
+    float yScale = 64.0f / 256.0f;
+    float yShift = 16.0f;
+
+    // error map from height map samples, 8-bit, 16-bit or float (only channel 0 is read)
+    template <typename Sample>
+    void build(const Sample *data, int width, int height, int nChannels)
+    {
+        std::vector<float> heights((size_t)width * height);
+        for (size_t i = 0; i < heights.size(); i++)
+            heights[i] = (float)data[i * nChannels] * yScale - yShift;
+        build(heights.data(), width, height);
+    }
+
+    // error map from world space heights, width * height, row by row
+    void build(const float *heights, int width, int height)
+    {
+        mSourceWidth = width;
+        mSourceHeight = height;
+        // smallest 2^k + 1 grid covering the height map, padding repeats the last row / column
+        mSize = 2;
+        while (mSize + 1 < std::max(width, height))
+            mSize *= 2;
+        mSize += 1;
+        terrain.resize((size_t)mSize * mSize);
+        for (int i = 0; i < mSize; i++)
+        {
+            const float *row = heights + (size_t)std::min(i, height - 1) * width;
+            for (int j = 0; j < mSize; j++)
+                terrain[(size_t)i * mSize + j] = row[std::min(j, width - 1)];
+        }
+        computeErrors();
+        indexOf.assign((size_t)mSize * mSize, 0);
+    }
+
+    // triangulate with at most maxError height difference to the grid
+    void extract(float maxError)
+    {
+        vertices.clear();
+        indices.clear();
+        // indexOf: output vertex + 1 of every grid vertex, 0 -> not emitted yet
+        std::fill(indexOf.begin(), indexOf.end(), 0);
+        const int max = mSize - 1;
+        processTriangle(0, 0, max, max, max, 0, maxError);
+        processTriangle(max, max, 0, 0, 0, max, maxError);
+    }
+
+    // vertices per side of the padded grid
+    int gridSize() const { return mSize; }
+    unsigned int numTriangles() const { return (unsigned int)(indices.size() / 3); }
+    unsigned int numVertices() const { return (unsigned int)(vertices.size() / 3); }
+
+    // upload the last extract(), creates the buffers on first use
+    void upload()
+    {
+        if (!vao)
+        {
+            glGenVertexArrays(1, &vao);
+            glGenBuffers(1, &vbo);
+            glGenBuffers(1, &ebo);
+        }
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+        glEnableVertexAttribArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+        uploadedIndices = (GLsizei)indices.size();
+    }
+
+    // one draw call, binds its own VAO
+    void draw() const
+    {
+        glBindVertexArray(vao);
+        glDrawElements(GL_TRIANGLES, uploadedIndices, GL_UNSIGNED_INT, (void *)0);
+    }
+
+private:
+    int mSize = 0;
+    int mSourceWidth = 0;
+    int mSourceHeight = 0;
+    int leafDepth = 0;
+    std::vector<float> terrain;
+    std::vector<float> errors;
+    std::vector<unsigned int> indexOf;
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLsizei uploadedIndices = 0;
+
+    // one pass per depth, from the leaves (single grid cells) up to the two halves
+    // -> the errors of all children are final before their parents read them
+    void computeErrors()
+    {
+        errors.assign((size_t)mSize * mSize, 0.0f);
+        leafDepth = 0;
+        for (int size = mSize - 1; size > 1; size >>= 1)
+            leafDepth += 2;
+        const int max = mSize - 1;
+        for (int depth = leafDepth; depth >= 1; depth--)
+        {
+            errorPass(0, 0, max, max, max, 0, 1, depth);
+            errorPass(max, max, 0, 0, 0, max, 1, depth);
+        }
+    }
+
+    // walk down to the triangles of the target depth, in recursion order -> neighbouring
+    // triangles are visited together, the grid is read with good locality
+    void errorPass(int ax, int ay, int bx, int by, int cx, int cy, int depth, int target)
+    {
+        const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+        if (depth < target)
+        {
+            errorPass(cx, cy, ax, ay, mx, my, depth + 1, target);
+            errorPass(bx, by, cx, cy, mx, my, depth + 1, target);
+            return;
+        }
+        const float interpolated = (terrain[(size_t)ay * mSize + ax] + terrain[(size_t)by * mSize + bx]) * 0.5f;
+        const size_t middle = (size_t)my * mSize + mx;
+        float &error = errors[middle];
+        error = std::max(error, std::fabs(interpolated - terrain[middle]));
+        if (depth < leafDepth)
+        {
+            // midpoints of the two children hypotenuses (c - a and b - c)
+            const size_t left = (size_t)((ay + cy) >> 1) * mSize + ((ax + cx) >> 1);
+            const size_t right = (size_t)((by + cy) >> 1) * mSize + ((bx + cx) >> 1);
+            error = std::max(error, std::max(errors[left], errors[right]));
+        }
+    }
+
+    // side of (x, y) relative to the line p -> q (sign of the cross product)
+    static long long side(int px, int py, int qx, int qy, int x, int y)
+    {
+        return (long long)(qx - px) * (y - py) - (long long)(qy - py) * (x - px);
+    }
+
+    // edge p -> q separates the triangle (third corner r) from the source rectangle
+    bool separates(int px, int py, int qx, int qy, int rx, int ry) const
+    {
+        const int maxX = mSourceWidth - 1, maxY = mSourceHeight - 1;
+        const long long inside = side(px, py, qx, qy, rx, ry);
+        const int cornersX[4] = {0, maxX, 0, maxX}, cornersY[4] = {0, 0, maxY, maxY};
+        for (int k = 0; k < 4; k++)
+        {
+            if (side(px, py, qx, qy, cornersX[k], cornersY[k]) * inside >= 0)
+                return false;
+        }
+        return true;
+    }
+
+    // any part of the triangle on the height map (separating axes: x, y and the three edges)
+    bool overlapsSource(int ax, int ay, int bx, int by, int cx, int cy) const
+    {
+        if (std::min(ax, std::min(bx, cx)) > mSourceWidth - 1 || std::min(ay, std::min(by, cy)) > mSourceHeight - 1)
+            return false;
+        return !separates(ax, ay, bx, by, cx, cy) && !separates(bx, by, cx, cy, ax, ay) && !separates(cx, cy, ax, ay, bx, by);
+    }
+
+    // grid vertex clamped onto the height map
+    unsigned int emitVertex(int x, int y)
+    {
+        x = std::min(x, mSourceWidth - 1);
+        y = std::min(y, mSourceHeight - 1);
+        unsigned int &index = indexOf[(size_t)y * mSize + x];
+        if (!index)
+        {
+            // same placement as TerrainMeshBuilder: row y -> x axis, column x -> z axis
+            vertices.push_back(-(mSourceHeight / 2.0f) + y);
+            vertices.push_back(terrain[(size_t)y * mSize + x]);
+            vertices.push_back(-(mSourceWidth / 2.0f) + x);
+            index = (unsigned int)(vertices.size() / 3);
+        }
+        return index - 1;
+    }
+
+    void processTriangle(int ax, int ay, int bx, int by, int cx, int cy, float maxError)
+    {
+        // all padding: nothing to draw, no need to split
+        if (!overlapsSource(ax, ay, bx, by, cx, cy))
+            return;
+        const int mx = (ax + bx) >> 1, my = (ay + by) >> 1;
+        if (std::abs(ax - cx) + std::abs(ay - cy) > 1 && errors[(size_t)my * mSize + mx] > maxError)
+        {
+            // split at the hypotenuse midpoint
+            processTriangle(cx, cy, ax, ay, mx, my, maxError);
+            processTriangle(bx, by, cx, cy, mx, my, maxError);
+            return;
+        }
+        const unsigned int a = emitVertex(ax, ay), b = emitVertex(bx, by), c = emitVertex(cx, cy);
+        // clamped onto a line of the border
+        if (a == b || b == c || c == a)
+            return;
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+};
+
+#endif
@@ -0,0 +1,13 @@
+// grey level of a terrain height, heights from SHADE_LOW up to SHADE_LOW + SHADE_RANGE
+// map to black .. white, both can be set per permutation
+#ifndef SHADE_LOW
+#define SHADE_LOW -16.0
+#endif
+#ifndef SHADE_RANGE
+#define SHADE_RANGE 32.0
+#endif
+
+float heightShade(float height)
+{
+    return (height - SHADE_LOW) / SHADE_RANGE;
+}
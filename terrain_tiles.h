@@ -0,0 +1,196 @@
+#ifndef TERRAIN_TILES_H
+#define TERRAIN_TILES_H
+
+/*
+* Terrain tiles & frustum culling
+- The grid is cut into tiles of tileSize x tileSize quads (see TerrainMeshBuilder)
+- Every tile gets an axis aligned bounding box (AABB)
+    - x, z: known from the tile position on the grid
+    - y:    min / max height of the vertices inside the tile
+- Boxes are stored as Structure of Arrays (SoA): minX[], minY[], ...
+  -> 4 tiles are tested at once with SIMD
+
+* Frustum planes
+- Extracted directly from the clip matrix M = projection * view * model
+  (Gribb & Hartmann): a point p is inside if for every plane (a, b, c, d)
+  a*p.x + b*p.y + c*p.z + d >= 0
+- left = row3 + row0, right = row3 - row0, bottom = row3 + row1,
+  top = row3 - row1, near = row3 + row2, far = row3 - row2
+
+* Box vs plane
+- Only the corner furthest along the plane normal ("positive vertex") matters:
+  if even that corner is behind the plane, the whole box is outside
+- The corner is chosen per plane, not per box -> no blend needed in the SIMD loop
+*/
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TERRAIN_CULL_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TERRAIN_CULL_NEON
+#endif
+
+struct Frustum
+{
+    // plane i: (a, b, c, d), normals point inside
+    glm::vec4 planes[6];
+
+    Frustum() {}
+    Frustum(const glm::mat4 &m)
+    {
+        // glm is column major: m[col][row]
+        for (int i = 0; i < 3; i++)
+        {
+            for (int k = 0; k < 4; k++)
+            {
+                planes[i * 2][k] = m[k][3] + m[k][i];
+                planes[i * 2 + 1][k] = m[k][3] - m[k][i];
+            }
+        }
+    }
+
+    // single box test, positive vertex against every plane
+    bool intersects(const glm::vec3 &boxMin, const glm::vec3 &boxMax) const
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = planes[p];
+            glm::vec3 positive(plane.x >= 0.0f ? boxMax.x : boxMin.x,
+                               plane.y >= 0.0f ? boxMax.y : boxMin.y,
+                               plane.z >= 0.0f ? boxMax.z : boxMin.z);
+            if (plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+class TerrainTiles
+{
+public:
+    // bounding boxes, padded to a multiple of 4 tiles
+    std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+    // tiles that passed the last cull, ascending order
+    std::vector<unsigned int> Visible;
+    unsigned int NumTiles = 0;
+    unsigned int CulledTiles = 0;
+
+    // bounds of every tile of a mesh built with tile size tileSize
+    // vertices: 3 floats per vertex, width * height vertices, row by row
+    TerrainTiles(const std::vector<float> &vertices, int width, int height, unsigned int tileSize);
+
+    // fill Visible with the tiles inside the frustum
+    void cull(const Frustum &frustum);
+
+private:
+    std::vector<unsigned char> outside;
+};
+
+TerrainTiles::TerrainTiles(const std::vector<float> &vertices, int width, int height, unsigned int tileSize)
+{
+    const unsigned int quadRows = height > 1 ? height - 1 : 0;
+    const unsigned int quadCols = width > 1 ? width - 1 : 0;
+    const unsigned int T = tileSize ? tileSize : (unsigned int)std::max(width, height);
+    const unsigned int tilesX = (quadRows + T - 1) / T;
+    const unsigned int tilesZ = std::max(1u, (quadCols + T - 1) / T);
+    NumTiles = tilesX * tilesZ;
+
+    // padding boxes are empty (min > max) and never reported
+    const size_t padded = (NumTiles + 3) & ~3u;
+    minX.assign(padded, FLT_MAX);  minY.assign(padded, FLT_MAX);  minZ.assign(padded, FLT_MAX);
+    maxX.assign(padded, -FLT_MAX); maxY.assign(padded, -FLT_MAX); maxZ.assign(padded, -FLT_MAX);
+    outside.assign(padded, 0);
+    Visible.reserve(NumTiles);
+
+    // tiles in the same order as the mesh batches: along x, then along z
+    for (unsigned int tx = 0; tx < tilesX; tx++)
+    {
+        const unsigned int r0 = tx * T, r1 = std::min(r0 + T, quadRows);
+        for (unsigned int tz = 0; tz < tilesZ; tz++)
+        {
+            const unsigned int c0 = tz * T, c1 = std::min(c0 + T, quadCols);
+            const unsigned int tile = tx * tilesZ + tz;
+            float lo = FLT_MAX, hi = -FLT_MAX;
+            for (unsigned int i = r0; i <= r1; i++)
+            {
+                const float *vertex = &vertices[((size_t)i * width + c0) * 3];
+                for (unsigned int j = c0; j <= c1; j++, vertex += 3)
+                {
+                    lo = std::min(lo, vertex[1]);
+                    hi = std::max(hi, vertex[1]);
+                }
+            }
+            // corners of the tile give x and z
+            const float *first = &vertices[((size_t)r0 * width + c0) * 3];
+            const float *last = &vertices[((size_t)r1 * width + c1) * 3];
+            minX[tile] = first[0]; maxX[tile] = last[0];
+            minY[tile] = lo;       maxY[tile] = hi;
+            minZ[tile] = first[2]; maxZ[tile] = last[2];
+        }
+    }
+}
+
+void TerrainTiles::cull(const Frustum &frustum)
+{
+    const size_t padded = minX.size();
+    std::fill(outside.begin(), outside.end(), 0);
+
+    for (int p = 0; p < 6; p++)
+    {
+        const glm::vec4 &plane = frustum.planes[p];
+        // positive vertex: max corner along the plane normal
+        const float *X = plane.x >= 0.0f ? maxX.data() : minX.data();
+        const float *Y = plane.y >= 0.0f ? maxY.data() : minY.data();
+        const float *Z = plane.z >= 0.0f ? maxZ.data() : minZ.data();
+#if defined(TERRAIN_CULL_SSE)
+        const __m128 a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y);
+        const __m128 c = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+        const __m128 zero = _mm_setzero_ps();
+        for (size_t i = 0; i < padded; i += 4)
+        {
+            __m128 dist = _mm_add_ps(_mm_mul_ps(a, _mm_loadu_ps(X + i)), d);
+            dist = _mm_add_ps(dist, _mm_mul_ps(b, _mm_loadu_ps(Y + i)));
+            dist = _mm_add_ps(dist, _mm_mul_ps(c, _mm_loadu_ps(Z + i)));
+            int mask = _mm_movemask_ps(_mm_cmplt_ps(dist, zero));
+            outside[i]     |= mask & 1;
+            outside[i + 1] |= (mask >> 1) & 1;
+            outside[i + 2] |= (mask >> 2) & 1;
+            outside[i + 3] |= (mask >> 3) & 1;
+        }
+#elif defined(TERRAIN_CULL_NEON)
+        const float32x4_t a = vdupq_n_f32(plane.x), b = vdupq_n_f32(plane.y);
+        const float32x4_t c = vdupq_n_f32(plane.z), d = vdupq_n_f32(plane.w);
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        for (size_t i = 0; i < padded; i += 4)
+        {
+            float32x4_t dist = vmlaq_f32(d, a, vld1q_f32(X + i));
+            dist = vmlaq_f32(dist, b, vld1q_f32(Y + i));
+            dist = vmlaq_f32(dist, c, vld1q_f32(Z + i));
+            uint32x4_t behind = vcltq_f32(dist, zero);
+            outside[i]     |= vgetq_lane_u32(behind, 0) & 1;
+            outside[i + 1] |= vgetq_lane_u32(behind, 1) & 1;
+            outside[i + 2] |= vgetq_lane_u32(behind, 2) & 1;
+            outside[i + 3] |= vgetq_lane_u32(behind, 3) & 1;
+        }
+#else
+        for (size_t i = 0; i < padded; i++)
+            outside[i] |= plane.x * X[i] + plane.y * Y[i] + plane.z * Z[i] + plane.w < 0.0f;
+#endif
+    }
+
+    Visible.clear();
+    for (unsigned int tile = 0; tile < NumTiles; tile++)
+    {
+        if (!outside[tile])
+            Visible.push_back(tile);
+    }
+    CulledTiles = NumTiles - (unsigned int)Visible.size();
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef TERRAIN_VERTEX_H
+#define TERRAIN_VERTEX_H
+
+/*
+* Terrain vertex formats
+- x and z of a grid vertex follow from its index v: row i = v / width, column j = v % width
+  -> only the height has to be stored, the vertex shader rebuilds x and z from gl_VertexID
+     (gl_VertexID includes the base vertex -> works with glDrawElementsBaseVertex too)
+- FLOAT3:    (x, y, z) floats, 12 bytes per vertex, what the mesh builder outputs
+- HEIGHT16:  one unsigned short per vertex, normalized to [0, 1] and mapped
+             back to [min, max] height in the shader, 2 bytes per vertex
+- TEXTURE:   no vertex buffer at all, the height is fetched from an R16 texture
+             with texelFetch(row, column), 2 bytes per vertex
+- 16 bits over the height range of the map: 8-bit height maps are stored exactly
+
+* Usage
+- bind(format, shader): binds the VAO of the format and sets the shader uniforms,
+  index buffers of TerrainDraw / TerrainLOD are rebound by their draw calls
+*/
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include "shaders.h"
+
+// Defines the vertex formats, values match VERTEX_FORMAT in height_shader.vs (a permutation per format)
+enum Vertex_Format {
+    VERTEX_FLOAT3,
+    VERTEX_HEIGHT16,
+    VERTEX_TEXTURE,
+    NUM_VERTEX_FORMATS
+};
+
+const char *const VERTEX_FORMAT_NAMES[NUM_VERTEX_FORMATS] = {
+    "float3",
+    "height16",
+    "texture"
+};
+
+class TerrainVertices
+{
+public:
+    // vertices: 3 floats per vertex, width * height vertices, row by row
+    TerrainVertices(const std::vector<float> &vertices, int width, int height);
+
+    // bind the VAO of a format and set its uniforms, shader must be in use
+    void bind(Vertex_Format format, Shader &shader) const;
+
+    // bytes of vertex data per format (GPU side)
+    size_t bytes(Vertex_Format format) const;
+    void printReport() const;
+
+private:
+    int gridWidth, gridHeight;
+    glm::vec2 gridOrigin;
+    float minHeight, heightRange;
+    GLuint vaos[NUM_VERTEX_FORMATS];
+    GLuint floatVBO, heightVBO, heightTexture;
+};
+
+TerrainVertices::TerrainVertices(const std::vector<float> &vertices, int width, int height)
+    : gridWidth(width), gridHeight(height)
+{
+    const size_t count = (size_t)width * height;
+    gridOrigin = glm::vec2(vertices[0], vertices[2]);
+    minHeight = FLT_MAX;
+    float maxHeight = -FLT_MAX;
+    for (size_t v = 0; v < count; v++)
+    {
+        minHeight = std::min(minHeight, vertices[v * 3 + 1]);
+        maxHeight = std::max(maxHeight, vertices[v * 3 + 1]);
+    }
+    heightRange = std::max(maxHeight - minHeight, FLT_MIN);
+
+    // quantize once, shared by the attribute and the texture
+    std::vector<unsigned short> heights(count);
+    for (size_t v = 0; v < count; v++)
+        heights[v] = (unsigned short)std::lround((vertices[v * 3 + 1] - minHeight) / heightRange * 65535.0f);
+
+    glGenVertexArrays(NUM_VERTEX_FORMATS, vaos);
+
+    // * float3: position attribute
+    glBindVertexArray(vaos[VERTEX_FLOAT3]);
+    glGenBuffers(1, &floatVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, floatVBO);
+    glBufferData(GL_ARRAY_BUFFER,
+                 vertices.size() * sizeof(float), // size of vertices buffer
+                 &vertices[0],                    // pointer to first element
+                 GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
+    glEnableVertexAttribArray(0);
+
+    // * height16: normalized height attribute
+    glBindVertexArray(vaos[VERTEX_HEIGHT16]);
+    glGenBuffers(1, &heightVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, heightVBO);
+    glBufferData(GL_ARRAY_BUFFER, heights.size() * sizeof(unsigned short), heights.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_TRUE, 0, (void *)0);
+    glEnableVertexAttribArray(1);
+
+    // * texture: no attributes, rows of the grid -> rows of the texture
+    glBindVertexArray(vaos[VERTEX_TEXTURE]);
+    glGenTextures(1, &heightTexture);
+    glBindTexture(GL_TEXTURE_2D, heightTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width, height, 0, GL_RED, GL_UNSIGNED_SHORT, heights.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glBindVertexArray(vaos[VERTEX_FLOAT3]);
+}
+
+void TerrainVertices::bind(Vertex_Format format, Shader &shader) const
+{
+    glBindVertexArray(vaos[format]);
+    shader.setInt("gridWidth", gridWidth);
+    shader.setVec2("gridOrigin", gridOrigin);
+    shader.setVec2("heightRange", glm::vec2(minHeight, heightRange));
+    if (format == VERTEX_TEXTURE)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, heightTexture);
+        shader.setInt("heightMap", 0);
+    }
+}
+
+size_t TerrainVertices::bytes(Vertex_Format format) const
+{
+    const size_t count = (size_t)gridWidth * gridHeight;
+    return format == VERTEX_FLOAT3 ? count * 3 * sizeof(float) : count * sizeof(unsigned short);
+}
+
+void TerrainVertices::printReport() const
+{
+    std::cout << "Vertex memory per format (" << gridWidth << " x " << gridHeight << " vertices)" << std::endl;
+    std::cout << std::left << std::setw(12) << "format" << std::right << std::setw(14) << "bytes/vertex"
+              << std::setw(12) << "MB" << std::setw(10) << "ratio" << std::endl;
+    const size_t count = (size_t)gridWidth * gridHeight;
+    for (int format = 0; format < NUM_VERTEX_FORMATS; format++)
+    {
+        const size_t size = bytes((Vertex_Format)format);
+        std::cout << std::left << std::setw(12) << VERTEX_FORMAT_NAMES[format] << std::right
+                  << std::setw(14) << size / count
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << size / (1024.0 * 1024.0)
+                  << std::setw(9) << (double)bytes(VERTEX_FLOAT3) / size << "x" << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+/*
+* Triple buffer
+- Hands the latest value of one thread (writer) to another (reader) without locks,
+  neither side ever waits for the other
+- Three slots: the writer fills the back slot, the reader uses the front slot,
+  the middle slot holds the latest published value
+- publish(): back <-> middle in one atomic exchange, marked fresh
+- read(): if the middle slot is fresh, front <-> middle in one atomic exchange,
+  then the front slot -> the newest value at the time of the call, values published
+  in between are skipped (the reader only wants the latest one)
+- Slot indices + fresh bit in one atomic -> no torn state, no ABA
+
+* Use
+- write() returns the back slot, it still holds a value from (at least) two publishes ago
+  -> the writer overwrites the whole value before publish()
+- One writer thread, one reader thread
+*/
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    // values published / read() calls that got a new value
+    unsigned long long Published = 0;
+    unsigned long long Consumed = 0;
+
+    // writer: slot to fill
+    T &write() { return slots[back]; }
+
+    // writer: the filled slot becomes the latest value
+    void publish()
+    {
+        // release: the slot's contents are visible to the reader that takes it
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX;
+        Published++;
+    }
+
+    // reader: latest published value (the same as before if nothing new was published)
+    const T &read()
+    {
+        if (middle.load(std::memory_order_relaxed) & FRESH)
+        {
+            // acquire: sees everything written to the slot before its publish()
+            front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+            Consumed++;
+        }
+        return slots[front];
+    }
+
+private:
+    static const unsigned int INDEX = 3;
+    static const unsigned int FRESH = 4;
+
+    T slots[3];
+    // writer only
+    unsigned int back = 0;
+    // index of the middle slot + FRESH, shared
+    alignas(64) std::atomic<unsigned int> middle{1};
+    // reader only
+    alignas(64) unsigned int front = 2;
+};
+
+#endif